@@ -1,162 +1,2486 @@
+#define _GNU_SOURCE  //qsort_r
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <immintrin.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//每行按8个int（32字节）对齐存放，行首地址按缓存行对齐
+#define ROW_ALIGN 8
+#define ROW(b,m,i) ((b)->m + (size_t)(i) * (b)->stride)
+//进程数不少于此值时safe()使用工作表算法。工作表每次都要把各资源列排序，
+//bench实测（-O2，16种资源）进程数到2500左右才追上逐轮扫描，这里留些余量
+#define SAFE_WORKLIST_MIN 3000
+//已释放进程在缓存序列中留下的位置，松弛量视为无穷大
+#define GHOST_SLACK (1 << 29)
+
+//bank_decide的结果
+#define BANK_OK 0
+#define BANK_OVER_AVAIL 1   //超过可用资源
+#define BANK_OVER_NEED 2    //超过最大需求
+#define BANK_UNSAFE 3       //分配后不安全
+#define BANK_INVALID 4      //申请或归还的数目为负
+#define BANK_BAD_PID 5      //进程号不存在
+#define BANK_NEED_FULL (-1) //bank_check：增量检查不能确定，需要完整检查
+
+typedef struct Banker {
+	int p, r;          //进程数、资源数
+	int stride;        //矩阵每行实际占用的int数
+	int *R, *v;        //每个资源的总数、可用数
+	int *c, *a, *need; //最大需求、已分配、仍需矩阵，按行连续存放
+	int *path, *vis;   //安全序列、安全检查时的完成标记
+	//工作表安全检查的临时空间，第一次使用时分配
+	long long *col;    //每个资源一列，(仍需量, 进程号)按仍需量排序
+	int *cnt, *heap, *ptr;
+	/*
+	 * 增量安全检查的缓存：上一次的安全序列seq，以及每个位置k的松弛量
+	 * slack_k = 轮到该进程时的可用量 - 它的仍需量。序列按blk分块，
+	 * 整块的增量记在blazy里，块内最小值记在bmin里（都不含blazy）。
+	 */
+	int path_ok;        //缓存是否对应当前状态
+	int swept;          //是否已释放过初始状态中已满足的进程
+	int seqlen, cap, blk;
+	int *seq, *pos;     //序列（-1为已释放进程留下的位置）、进程在序列中的位置
+	int *slack, *bmin, *blazy;
+	int *tot, *tmp;     //v加上全部已分配量、临时行
+	void* map;          //快照映射，非NULL时R、v、c、a、need指向其中
+	size_t maplen;
+} Banker;
+
+typedef struct BankRequest {  //批量分配中的一个请求
+	int num;          //进程号
+	const int* req;   //申请向量，按stride补齐且补齐部分为0
+} BankRequest;
+
+//批量分配时对被拒绝的请求最多重试的轮数
+#define BATCH_PASSES 3
 
-#define max 100
 //functuin statement
-void menu();
-void prin();
-void bank();
-int safe();
-
-int p, r, R[max], v[max], c[max][max], a[max][max], path[max], vis[max];
-
-int main()
-{		
-	printf("请输入进程数p\n");
-	scanf("%d",&p);
-	printf("请输入资源数r\n");
-	scanf("%d",&r);
-	printf("请分别输入每个资源的总个数r[]\n");
-	for(int i=0;i<r;i++) scanf("%d",&R[i]);
-	printf("请分别输入每个资源的可用个数v[]\n");
-	for(int i=0;i<r;i++) scanf("%d",&v[i]);
-	printf("请输入每个进程对资源的最大需求矩阵c[][]\n");
-	for(int i=0;i<p;i++)
-		for(int j=0;j<r;j++)
-			scanf("%d",&c[i][j]);
-	printf("请输入每个进程对资源的已分配的矩阵a[][]\n");
-	for(int i=0;i<p;i++)
-		for(int j=0;j<r;j++)
-			scanf("%d",&a[i][j]);
-	menu();
-}
-void menu()
+Banker* banker_new(int p, int r);
+void banker_free(Banker* b);
+void menu(Banker* b);
+void prin(Banker* b);
+void bank(Banker* b);
+int safe(Banker* b);
+int safe_scan(Banker* b);
+int safe_worklist(Banker* b);
+int safe_parallel(Banker* b, int nt, int* rounds);
+int bank_decide(Banker* b, int num, const int* req);
+int bank_check(Banker* b, int num, const int* req, int* tmp);
+int bank_commit(Banker* b, int num, const int* req, int checked);
+int bank_release(Banker* b, int num, const int* rel);
+int bank_batch(Banker* b, const BankRequest* reqs, int n, int* verdict);
+void bank_menu_batch(Banker* b);
+void cache_build(Banker* b, const int* order);
+void fill_path(Banker* b);
+void simd_init();
+void bench_simd();
+void bench_mt(int maxThreads);
+void detect_mode();
+void bench_par(int maxThreads);
+Banker* banker_load(const char* path);
+Banker* banker_map(const char* path);
+int snap_write(Banker* b, const char* path);
+int replay(Banker* b, const char* path, int quiet);
+void enum_report(Banker* b, int samples);
+int gen_main(int argc, char* argv[]);
+
+/*
+ * 向量比较与累加：x、y都是按ROW_ALIGN补齐的行，补齐部分为0。
+ * simd_init()按CPU是否支持AVX2选择实现。
+ */
+int (*vec_le)(const int* x, const int* y, int n);  //x[j] <= y[j]对所有j成立
+void (*vec_add)(int* x, const int* y, int n);      //x += y
+void (*vec_sub)(int* x, const int* y, int n);      //x -= y
+void (*vec_min)(int* x, const int* y, int n);      //x = min(x, y)
+
+static int* alloc_ints(size_t n)  //按缓存行对齐分配并清零
+{
+	size_t bytes = (n * sizeof(int) + 63) / 64 * 64;
+	int* m = aligned_alloc(64, bytes ? bytes : 64);
+	if(m == NULL) {
+		printf("内存不足!\n");
+		exit(1);
+	}
+	memset(m, 0, bytes);
+	return m;
+}
+
+static int vec_le_scalar(const int* x, const int* y, int n)
+{
+	for(int j=0;j<n;j++)
+		if(x[j] > y[j]) return 0;
+	return 1;
+}
+
+static void vec_add_scalar(int* x, const int* y, int n)
+{
+	for(int j=0;j<n;j++) x[j] += y[j];
+}
+
+static void vec_sub_scalar(int* x, const int* y, int n)
+{
+	for(int j=0;j<n;j++) x[j] -= y[j];
+}
+
+static void vec_min_scalar(int* x, const int* y, int n)
+{
+	for(int j=0;j<n;j++)
+		if(y[j] < x[j]) x[j] = y[j];
+}
+
+__attribute__((target("avx2")))
+static int vec_le_avx2(const int* x, const int* y, int n)
+{
+	for(int j=0;j<n;j+=8) {
+		__m256i gt = _mm256_cmpgt_epi32(_mm256_load_si256((const __m256i*)(x + j)),
+			_mm256_load_si256((const __m256i*)(y + j)));
+		if(!_mm256_testz_si256(gt, gt)) return 0;
+	}
+	return 1;
+}
+
+__attribute__((target("avx2")))
+static void vec_add_avx2(int* x, const int* y, int n)
+{
+	for(int j=0;j<n;j+=8) {
+		__m256i* px = (__m256i*)(x + j);
+		_mm256_store_si256(px, _mm256_add_epi32(_mm256_load_si256(px),
+			_mm256_load_si256((const __m256i*)(y + j))));
+	}
+}
+
+__attribute__((target("avx2")))
+static void vec_sub_avx2(int* x, const int* y, int n)
+{
+	for(int j=0;j<n;j+=8) {
+		__m256i* px = (__m256i*)(x + j);
+		_mm256_store_si256(px, _mm256_sub_epi32(_mm256_load_si256(px),
+			_mm256_load_si256((const __m256i*)(y + j))));
+	}
+}
+
+__attribute__((target("avx2")))
+static void vec_min_avx2(int* x, const int* y, int n)
+{
+	for(int j=0;j<n;j+=8) {
+		__m256i* px = (__m256i*)(x + j);
+		_mm256_store_si256(px, _mm256_min_epi32(_mm256_load_si256(px),
+			_mm256_load_si256((const __m256i*)(y + j))));
+	}
+}
+
+void simd_init()
+{
+	if(vec_le) return;
+	if(__builtin_cpu_supports("avx2")) {
+		vec_le = vec_le_avx2;
+		vec_add = vec_add_avx2;
+		vec_sub = vec_sub_avx2;
+		vec_min = vec_min_avx2;
+	}
+	else {
+		vec_le = vec_le_scalar;
+		vec_add = vec_add_scalar;
+		vec_sub = vec_sub_scalar;
+		vec_min = vec_min_scalar;
+	}
+}
+
+static Banker* banker_shell(int p, int r)  //分配R、v、c、a、need以外的部分
+{
+	Banker* b = malloc(sizeof(Banker));
+	simd_init();
+	b->p = p;
+	b->r = r;
+	b->stride = (r + ROW_ALIGN - 1) / ROW_ALIGN * ROW_ALIGN;
+	b->map = NULL;
+	b->maplen = 0;
+	b->path = alloc_ints(p);
+	b->vis = alloc_ints(p);
+	b->col = NULL;
+	b->cnt = b->heap = b->ptr = NULL;
+	b->path_ok = b->swept = 0;
+	b->seq = b->pos = NULL;
+	b->slack = b->bmin = b->blazy = NULL;
+	b->tot = alloc_ints(b->stride);
+	b->tmp = alloc_ints(b->stride);
+	return b;
+}
+
+Banker* banker_new(int p, int r)
+{
+	Banker* b = banker_shell(p, r);
+	b->R = alloc_ints(b->stride);
+	b->v = alloc_ints(b->stride);
+	b->c = alloc_ints((size_t)p * b->stride);
+	b->a = alloc_ints((size_t)p * b->stride);
+	b->need = alloc_ints((size_t)p * b->stride);
+	return b;
+}
+
+void banker_free(Banker* b)
+{
+	if(b->map) munmap(b->map, b->maplen);
+	else {
+		free(b->R); free(b->v);
+		free(b->c); free(b->a); free(b->need);
+	}
+	free(b->path); free(b->vis);
+	free(b->col); free(b->cnt); free(b->heap); free(b->ptr);
+	free(b->seq); free(b->pos);
+	free(b->slack); free(b->bmin); free(b->blazy);
+	free(b->tot); free(b->tmp);
+	free(b);
+}
+
+void update_need(Banker* b, int i)  //重新计算第i行的仍需向量
+{
+	int *c = ROW(b,c,i), *a = ROW(b,a,i), *n = ROW(b,need,i);
+	for(int j=0;j<b->r;j++)
+		n[j] = c[j] - a[j];
+}
+
+int main(int argc, char* argv[])
+{
+	int p, r;
+	if(argc > 1 && strcmp(argv[1], "simd") == 0) {  //./banker simd
+		bench_simd();
+		return 0;
+	}
+	if(argc > 1 && strcmp(argv[1], "detect") == 0) {  //./banker detect 死锁检测模式
+		detect_mode();
+		return 0;
+	}
+	if(argc > 1 && strcmp(argv[1], "par") == 0) {  //./banker par [线程数]
+		bench_par(argc > 2 ? atoi(argv[2]) : 4);
+		return 0;
+	}
+	if(argc > 1 && (strcmp(argv[1], "gen") == 0 || strcmp(argv[1], "bench") == 0))
+		return gen_main(argc - 1, argv + 1);  //./banker gen|bench [选项]
+	if(argc > 1 && strcmp(argv[1], "mt") == 0) {  //./banker mt [线程数]
+		bench_mt(argc > 2 ? atoi(argv[2]) : 4);
+		return 0;
+	}
+	/*
+	 * ./banker [-f 场景文件 | -s 快照] [-w 快照] [-l 请求日志] [-e 抽样数] [-q]
+	 * 没有-f、-s时从标准输入读取状态；有-l时回放日志后退出，
+	 * 有-e时统计安全序列后退出，只有-w时写出快照后退出，否则进入交互菜单。
+	 */
+	const char *scen = NULL, *snap = NULL, *out = NULL, *log = NULL;
+	int opt, quiet = 0, samples = -1;
+	while((opt = getopt(argc, argv, "f:s:w:l:e:q")) != -1) {
+		switch(opt) {
+		case 'f': scen = optarg; break;
+		case 's': snap = optarg; break;
+		case 'w': out = optarg; break;
+		case 'l': log = optarg; break;
+		case 'e': samples = atoi(optarg); break;
+		case 'q': quiet = 1; break;
+		default:
+			printf("用法: %s [-f 场景文件 | -s 快照] [-w 快照] [-l 请求日志] [-e 抽样数] [-q]\n", argv[0]);
+			printf("      %s simd | detect | par [线程数] | mt [线程数]\n", argv[0]);
+			printf("      %s gen|bench [-p 进程数] [-r 资源数] [-u 利用率] [-k 争用度] [-n 操作数] [-S 种子] [-t 线程数] [-o 场景文件] [-L 请求日志]\n", argv[0]);
+			return 1;
+		}
+	}
+	Banker* b;
+	if(snap) b = banker_map(snap);
+	else if(scen) b = banker_load(scen);
+	else {
+		printf("请输入进程数p\n");
+		scanf("%d",&p);
+		printf("请输入资源数r\n");
+		scanf("%d",&r);
+		if(p <= 0 || r <= 0) {
+			printf("进程数和资源数必须为正数!\n");
+			return 1;
+		}
+		b = banker_new(p, r);
+		printf("请分别输入每个资源的总个数r[]\n");
+		for(int i=0;i<r;i++) scanf("%d",&b->R[i]);
+		printf("请分别输入每个资源的可用个数v[]\n");
+		for(int i=0;i<r;i++) scanf("%d",&b->v[i]);
+		printf("请输入每个进程对资源的最大需求矩阵c[][]\n");
+		for(int i=0;i<p;i++)
+			for(int j=0;j<r;j++)
+				scanf("%d",&ROW(b,c,i)[j]);
+		printf("请输入每个进程对资源的已分配的矩阵a[][]\n");
+		for(int i=0;i<p;i++)
+			for(int j=0;j<r;j++)
+				scanf("%d",&ROW(b,a,i)[j]);
+		for(int i=0;i<p;i++)
+			update_need(b, i);
+	}
+	if(b == NULL) return 1;
+	int ret = 0;
+	if(out && snap_write(b, out) != 0) ret = 1;
+	if(log) {
+		if(replay(b, log, quiet) != 0) ret = 1;
+	}
+	else if(samples >= 0) enum_report(b, samples);
+	else if(!out) menu(b);
+	banker_free(b);
+	return ret;
+}
+void menu(Banker* b)
 {
 	int op;
-	printf("请输入操作: 1.请求分配资源 2.显示当前状态 3.退出\n");
-	scanf("%d",&op);
-	if(op==1) {bank();menu();}
-	else if(op==2) {prin();menu();}
+	printf("请输入操作: 1.请求分配资源 2.显示当前状态 3.退出 4.批量请求分配 5.统计安全序列\n");
+	if(scanf("%d",&op) != 1) return;
+	if(op==1) {bank(b);menu(b);}
+	else if(op==2) {prin(b);menu(b);}
+	else if(op==4) {bank_menu_batch(b);menu(b);}
+	else if(op==5) {enum_report(b, 5);menu(b);}
 	else return;
 }
 
-void bank()  // allocate resource
+void bank(Banker* b)  // allocate resource
 {
-	int num;
-	int bank[max];
+	int num, r = b->r;
+	int* bank = alloc_ints(b->stride);
 	printf("请输入需要分配的进程\n");
 	scanf("%d",&num);
-	printf("请分别输入分配的资源数目\n"); 
+	if(num < 0 || num >= b->p) {
+		printf("进程号不存在!\n");
+		free(bank);
+		return ;
+	}
+	printf("请分别输入分配的资源数目\n");
 	for(int i=0;i<r;i++)
 		scanf("%d",&bank[i]);
-	int flag=1;
-	for(int i=0;i<r;i++) {
-		if(bank[i]>v[i])
-			flag=0;
-	}
-	if(flag==0) {
+	switch(bank_decide(b, num, bank)) {
+	case BANK_OVER_AVAIL:
 		printf("分配已超过已有资源!\n");
-		return ;
-	}
-	flag=1;
-	for(int i=0;i<r;i++) {
-		if((bank[i]+a[num][i])>c[num][i])
-		flag=0;
-	 }
-	 if(flag==0) {
+		break;
+	case BANK_OVER_NEED:
 	 	printf("分配已超过所需最大值!\n");
-	 	return ;
-	  }
-
-	for(int i=0;i<r;i++) {
-		a[num][i]=a[num][i]+bank[i];
-		v[i]=v[i]-bank[i];
-	}
-	if(safe()==1) {
+		break;
+	case BANK_UNSAFE:
+        printf("该状态不安全资源分配失败!\n");
+		break;
+	case BANK_INVALID:
+		printf("资源数目不能为负!\n");
+		break;
+	default:
 		printf("资源分配成功!");
 		printf("安全路径是：");
-        for(int i=0;i<p;i++)
-			printf("%2d",path[i]); 
-        for(int i = 0; i < p; i++) {
-		   	int j;
-        	for(j = 0; j < r; j++) {
-                if(a[i][j] != c[i][j])
-                    break;
-            }
-            if(j == r) {
-                for(j = 0; j < r; j++) {
-                    v[j] += a[i][j];
-                    a[i][j] = 0;
-                }
-            }
-        }
+		if(b->path_ok) fill_path(b);
+		else safe(b);  //缓存已失效，path是旧的；分配后的状态安全，重新求一遍
+        for(int i=0;i<b->p;i++)
+			printf("%2d",b->path[i]);
 		printf("\n");
-    }
-    else  {
-        printf("该状态不安全资源分配失败!\n");
-        for(int i = 0; i < r; i++) {
-            a[num][i] -= bank[i]; 
-		    v[i] += bank[i];
-        }
-    }
+	}
+	free(bank);
 }
 
-void prin()   //display the state
+void prin(Banker* b)   //display the state
 {
 	printf("总需求向量c[][]\n");
-	for(int i=0;i<p;i++){ 
-		for(int j=0;j<r;j++)
-			printf("%2d",c[i][j]);
+	for(int i=0;i<b->p;i++){
+		for(int j=0;j<b->r;j++)
+			printf("%2d",ROW(b,c,i)[j]);
 		printf("\n");
 	}
 	printf("已分配向量a[][]\n");
-	for(int i=0;i<p;i++){
-		for(int j=0;j<r;j++)
-			printf("%2d",a[i][j]);
+	for(int i=0;i<b->p;i++){
+		for(int j=0;j<b->r;j++)
+			printf("%2d",ROW(b,a,i)[j]);
 		printf("\n");
 	}
 	printf("仍需向量\n");
-	for(int i=0;i<p;i++){
-		for(int j=0;j<r;j++)
-			printf("%2d",c[i][j]-a[i][j]);
+	for(int i=0;i<b->p;i++){
+		for(int j=0;j<b->r;j++)
+			printf("%2d",ROW(b,need,i)[j]);
 		printf("\n");
 	}
 	printf("可用资源\n");
-	for(int i=0;i<r;i++){
-		printf("%2d",v[i]);
+	for(int i=0;i<b->r;i++){
+		printf("%2d",b->v[i]);
 	printf("\n");
 	}
 }
 
-int safe() {    //detect if the state is safe or not
-    int curV[max]; 
-    for(int i = 0; i < r; i++)
-        curV[i] = v[i];
-    memset(vis, 0, sizeof(vis));
+int safe(Banker* b) {    //detect if the state is safe or not
+    if(b->p >= SAFE_WORKLIST_MIN)
+        return safe_worklist(b);
+    return safe_scan(b);
+}
+
+int safe_scan(Banker* b) {    //逐轮扫描所有进程，O(p*p*r)
+    int p = b->p;
+    int* curV = alloc_ints(b->stride);
+    memcpy(curV, b->v, b->stride * sizeof(int));
+    memset(b->vis, 0, p * sizeof(int));
     int flag = 1;
     for(int i1 = 0; i1 < p; i1++) {
         int i;
         for(i = 0; i < p; i++) {
-            if(vis[i] == 1) continue;
-            int flagpro = 1;
-            for(int j = 0; j < r; j++) {
-                if(c[i][j] - a[i][j] > curV[j]) {
-                    flagpro = 0; break;
-                }
-            }
-            if(flagpro) {
-                path[i1] = i;
-                vis[i] = 1;
-                for(int k = 0; k < r; k++)
-                    curV[k] += a[i][k];
+            if(b->vis[i] == 1) continue;
+            if(vec_le(ROW(b,need,i), curV, b->stride)) {
+                b->path[i1] = i;
+                b->vis[i] = 1;
+                vec_add(curV, ROW(b,a,i), b->stride);
                 break;
             }
         }
         if(i == p) {
             flag = 0;
+            break;
         }
     }
- 	if(flag==1)
-    return 1;
+    free(curV);
+    return flag;
+}
+
+static int cmp_key(const void* x, const void* y)
+{
+    long long u = *(const long long*)x, w = *(const long long*)y;
+    return (u > w) - (u < w);
+}
+
+static void heap_push(int* heap, int* n, int x)  //进程号小根堆
+{
+    int k = (*n)++;
+    while(k > 0 && heap[(k - 1) / 2] > x) {
+        heap[k] = heap[(k - 1) / 2];
+        k = (k - 1) / 2;
+    }
+    heap[k] = x;
+}
+
+static int heap_pop(int* heap, int* n)
+{
+    int top = heap[0], x = heap[--(*n)], k = 0;
+    while(2 * k + 1 < *n) {
+        int c = 2 * k + 1;
+        if(c + 1 < *n && heap[c + 1] < heap[c]) c++;
+        if(heap[c] >= x) break;
+        heap[k] = heap[c];
+        k = c;
+    }
+    if(*n > 0) heap[k] = x;
+    return top;
+}
+
+/*
+ * 工作表算法：cnt[i]记录进程i还有几种资源的仍需量超过当前可用量。
+ * 每个资源的进程按仍需量排序，ptr[j]指向第一个还不能满足的进程；
+ * 可用量增加时只需把ptr[j]向后推，越过的进程cnt减一，减到0就可以完成。
+ * 可完成的进程放进小根堆，每次取进程号最小的，得到的安全序列与
+ * safe_scan相同。总代价O(p*r*log p)，主要是排序。
+ */
+int safe_worklist(Banker* b)
+{
+    int p = b->p, r = b->r;
+    if(b->col == NULL) {
+        b->col = malloc((size_t)p * r * sizeof(long long));
+        b->cnt = alloc_ints(p);
+        b->heap = alloc_ints(p);
+        b->ptr = alloc_ints(r);
+    }
+    int* curV = alloc_ints(r);
+    int hn = 0, k = 0;
+    for(int i = 0; i < p; i++) {
+        b->cnt[i] = r;
+        b->vis[i] = 0;
+    }
+    for(int j = 0; j < r; j++) {
+        long long* col = b->col + (size_t)j * p;
+        curV[j] = b->v[j];
+        for(int i = 0; i < p; i++)
+            col[i] = ROW(b,need,i)[j] * 4294967296LL + i;
+        qsort(col, p, sizeof(long long), cmp_key);
+        b->ptr[j] = 0;
+    }
+    for(int j = 0; j < r; j++) {
+        long long* col = b->col + (size_t)j * p;
+        int t = b->ptr[j];
+        while(t < p && ROW(b,need,(int)(col[t] & 0xffffffff))[j] <= curV[j]) {
+            int i = (int)(col[t++] & 0xffffffff);
+            if(--b->cnt[i] == 0) heap_push(b->heap, &hn, i);
+        }
+        b->ptr[j] = t;
+    }
+    while(hn > 0) {
+        int i = heap_pop(b->heap, &hn);
+        int* a = ROW(b,a,i);
+        b->path[k++] = i;
+        b->vis[i] = 1;
+        for(int j = 0; j < r; j++) {
+            if(a[j] == 0) continue;  //可用量没变，不会有新进程越过阈值
+            long long* col = b->col + (size_t)j * p;
+            int t = b->ptr[j];
+            curV[j] += a[j];
+            while(t < p && ROW(b,need,(int)(col[t] & 0xffffffff))[j] <= curV[j]) {
+                int w = (int)(col[t++] & 0xffffffff);
+                if(--b->cnt[w] == 0) heap_push(b->heap, &hn, w);
+            }
+            b->ptr[j] = t;
+        }
+    }
+    free(curV);
+    return k == p;
+}
+
+/*
+ * 并行安全检查：每一轮由各线程分段扫描所有未完成的进程，
+ * 找出仍需量不超过本轮开始时可用量的进程，各自把它们的已分配量
+ * 累加到私有行；轮末由0号线程合并私有行、压缩未完成表，再开始下一轮。
+ * 可用量只增不减，本轮能完成的进程在串行算法里也一定能完成，
+ * 所以是否安全与safe_scan一致；path按轮次、轮内按进程号排列，
+ * 是一个合法的安全序列，但不一定与串行算法的序列相同。
+ */
+typedef struct ParSafe {
+    Banker* b;
+    int nt;
+    int *live, nlive;  //未完成的进程
+    int *hit;          //本轮live[k]是否可以完成
+    int *curV, *part;  //当前可用量、每个线程的私有累加行
+    int k, done, rounds;
+    pthread_barrier_t bar;
+} ParSafe;
+
+typedef struct ParArg {
+    ParSafe* ps;
+    int t;
+} ParArg;
+
+static void* safe_parallel_worker(void* arg)
+{
+    ParSafe* ps = ((ParArg*)arg)->ps;
+    int t = ((ParArg*)arg)->t;
+    Banker* b = ps->b;
+    int* part = ps->part + (size_t)t * b->stride;
+    while(1) {
+        pthread_barrier_wait(&ps->bar);
+        if(ps->done) break;
+        int lo = (int)((long long)ps->nlive * t / ps->nt);
+        int hi = (int)((long long)ps->nlive * (t + 1) / ps->nt);
+        memset(part, 0, b->stride * sizeof(int));
+        for(int k = lo; k < hi; k++) {
+            int i = ps->live[k];
+            ps->hit[k] = vec_le(ROW(b,need,i), ps->curV, b->stride);
+            if(ps->hit[k]) vec_add(part, ROW(b,a,i), b->stride);
+        }
+        pthread_barrier_wait(&ps->bar);
+        if(t != 0) continue;
+        int n = 0, found = 0;  //0号线程合并本轮结果
+        for(int k = 0; k < ps->nlive; k++) {
+            int i = ps->live[k];
+            if(ps->hit[k]) {
+                b->path[ps->k++] = i;
+                b->vis[i] = 1;
+                found = 1;
+            }
+            else ps->live[n++] = i;
+        }
+        for(int u = 0; u < ps->nt; u++)
+            vec_add(ps->curV, ps->part + (size_t)u * b->stride, b->stride);
+        ps->nlive = n;
+        ps->rounds++;
+        ps->done = !found || n == 0;
+    }
+    return NULL;
+}
+
+int safe_parallel(Banker* b, int nt, int* rounds)  //nt个线程的并行安全检查
+{
+    int p = b->p;
+    ParSafe ps;
+    if(nt < 1) nt = 1;
+    ps.b = b;
+    ps.nt = nt;
+    ps.live = alloc_ints(p);
+    ps.hit = alloc_ints(p);
+    ps.curV = alloc_ints(b->stride);
+    ps.part = alloc_ints((size_t)nt * b->stride);
+    ps.nlive = p;
+    ps.k = ps.done = ps.rounds = 0;
+    memcpy(ps.curV, b->v, b->stride * sizeof(int));
+    for(int i = 0; i < p; i++) {
+        ps.live[i] = i;
+        b->vis[i] = 0;
+    }
+    pthread_barrier_init(&ps.bar, NULL, nt);
+    pthread_t* tid = malloc(nt * sizeof(pthread_t));
+    ParArg* arg = malloc(nt * sizeof(ParArg));
+    for(int t = 0; t < nt; t++) {
+        arg[t].ps = &ps;
+        arg[t].t = t;
+        if(t > 0) pthread_create(&tid[t], NULL, safe_parallel_worker, &arg[t]);
+    }
+    safe_parallel_worker(&arg[0]);
+    for(int t = 1; t < nt; t++) pthread_join(tid[t], NULL);
+    pthread_barrier_destroy(&ps.bar);
+    free(tid); free(arg);
+    free(ps.live); free(ps.hit); free(ps.curV); free(ps.part);
+    if(rounds) *rounds = ps.rounds;
+    return ps.k == p;
+}
+
+/*
+ * 枚举安全序列：count(S)为已完成集合S之后还有多少种完成顺序，
+ * count(S) = 所有能被avail(S)满足的i的count(S+{i})之和，
+ * avail(S) = v + S中进程已分配量之和只由S决定，所以按S记忆化，
+ * 状态数最多2^p而不是p!。S用p位的位图表示，存在开放寻址的散列表里。
+ * 剪枝：可用量只增不减，若S之后剩下的进程都已能满足，任意顺序都安全，
+ * count(S)直接等于剩余个数的阶乘，不再展开也不存表。
+ */
+typedef struct SeqEnum {
+    Banker* b;
+    int W;                      //位图占几个unsigned long long
+    unsigned long long *S;      //当前已完成集合
+    unsigned long long *keys;   //散列表
+    double *val;
+    char *used;
+    size_t cap, n;
+    size_t limit;               //散列表的内存上限（字节）
+    int overflow;               //散列表再扩容就超过limit，放弃枚举
+    int *av;                    //每层的可用量，p+1行
+    int *earliest;              //每个进程在安全序列中最早能排的位置
+    double *fact;
+} SeqEnum;
+
+static size_t seq_hash(const unsigned long long* key, int W)
+{
+    unsigned long long h = 0x9e3779b97f4a7c15ULL;
+    for(int w = 0; w < W; w++) {
+        h ^= key[w] + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        h *= 0xbf58476d1ce4e5b9ULL;
+    }
+    return (size_t)(h ^ (h >> 31));
+}
+
+static double* seq_find(SeqEnum* e, const unsigned long long* key)
+{
+    size_t k = seq_hash(key, e->W) & (e->cap - 1);
+    while(e->used[k]) {
+        if(memcmp(e->keys + k * e->W, key, e->W * sizeof(unsigned long long)) == 0) return &e->val[k];
+        k = (k + 1) & (e->cap - 1);
+    }
+    return NULL;
+}
+
+static size_t seq_bytes(const SeqEnum* e, size_t cap)  //容量为cap的散列表占用的内存
+{
+    return cap * (e->W * sizeof(unsigned long long) + sizeof(double) + 1);
+}
+
+static void seq_put(SeqEnum* e, const unsigned long long* key, double x)
+{
+    if(2 * (e->n + 1) > e->cap) {  //装载因子超过一半时扩容
+        if(seq_bytes(e, 2 * e->cap) > e->limit) {
+            e->overflow = 1;
+            return;
+        }
+        size_t old = e->cap;
+        unsigned long long* keys = e->keys;
+        double* val = e->val;
+        char* used = e->used;
+        e->cap *= 2;
+        e->keys = malloc(e->cap * e->W * sizeof(unsigned long long));
+        e->val = malloc(e->cap * sizeof(double));
+        e->used = calloc(e->cap, 1);
+        e->n = 0;
+        for(size_t k = 0; k < old; k++)
+            if(used[k]) seq_put(e, keys + k * e->W, val[k]);
+        free(keys); free(val); free(used);
+    }
+    size_t k = seq_hash(key, e->W) & (e->cap - 1);
+    while(e->used[k]) k = (k + 1) & (e->cap - 1);
+    memcpy(e->keys + k * e->W, key, e->W * sizeof(unsigned long long));
+    e->val[k] = x;
+    e->used[k] = 1;
+    e->n++;
+}
+
+#define SEQ_IN(S,i) ((S)[(i) >> 6] >> ((i) & 63) & 1)
+#define SEQ_FLIP(S,i) ((S)[(i) >> 6] ^= 1ULL << ((i) & 63))
+
+static double seq_count(SeqEnum* e, int done)
+{
+    Banker* b = e->b;
+    int p = b->p, all = 1;
+    int *avail = e->av + (size_t)done * b->stride, *next = avail + b->stride;
+    if(done == p) return 1;
+    double* hit = seq_find(e, e->S);
+    if(hit) return *hit;
+    for(int i = 0; i < p; i++) {
+        if(SEQ_IN(e->S, i)) continue;
+        if(vec_le(ROW(b,need,i), avail, b->stride)) {
+            if(done < e->earliest[i]) e->earliest[i] = done;
+        }
+        else all = 0;
+    }
+    if(all) return e->fact[p - done];
+    if(e->overflow) return 0;
+    double res = 0;
+    for(int i = 0; i < p && !e->overflow; i++) {
+        if(SEQ_IN(e->S, i) || !vec_le(ROW(b,need,i), avail, b->stride)) continue;
+        memcpy(next, avail, b->stride * sizeof(int));
+        vec_add(next, ROW(b,a,i), b->stride);
+        SEQ_FLIP(e->S, i);
+        res += seq_count(e, done + 1);
+        SEQ_FLIP(e->S, i);
+    }
+    if(!e->overflow) seq_put(e, e->S, res);
+    return res;
+}
+
+void seq_enum_init(SeqEnum* e, Banker* b, size_t limit)
+{
+    int p = b->p;
+    e->b = b;
+    e->W = (p + 63) / 64;
+    e->S = calloc(e->W, sizeof(unsigned long long));
+    e->cap = 1024;
+    e->n = 0;
+    e->limit = limit;
+    e->overflow = 0;
+    e->keys = malloc(e->cap * e->W * sizeof(unsigned long long));
+    e->val = malloc(e->cap * sizeof(double));
+    e->used = calloc(e->cap, 1);
+    e->av = alloc_ints((size_t)(p + 1) * b->stride);
+    e->earliest = malloc(p * sizeof(int));
+    e->fact = malloc((p + 1) * sizeof(double));
+    e->fact[0] = 1;
+    for(int k = 1; k <= p; k++) e->fact[k] = e->fact[k - 1] * k;
+    for(int i = 0; i < p; i++) e->earliest[i] = p;  //p表示不在任何安全序列中
+}
+
+void seq_enum_free(SeqEnum* e)
+{
+    free(e->S); free(e->keys); free(e->val); free(e->used);
+    free(e->av); free(e->earliest); free(e->fact);
+}
+
+//返回安全序列的个数（超过2^53时为近似值），散列表超过内存上限时e->overflow置1
+double seq_enum_count(SeqEnum* e)
+{
+    Banker* b = e->b;
+    int p = b->p;
+    memcpy(e->av, b->v, b->stride * sizeof(int));
+    int* curV = e->av + (size_t)p * b->stride;  //先贪心判断是否安全，不安全时不必搜索
+    char* fin = calloc(p, 1);
+    int k = 0, progress = 1;
+    memcpy(curV, b->v, b->stride * sizeof(int));
+    while(progress) {
+        progress = 0;
+        for(int i = 0; i < p; i++)
+            if(!fin[i] && vec_le(ROW(b,need,i), curV, b->stride)) {
+                vec_add(curV, ROW(b,a,i), b->stride);
+                fin[i] = 1;
+                progress = 1;
+                k++;
+            }
+    }
+    free(fin);
+    if(k < p) return 0;
+    return seq_count(e, 0);
+}
+
+/*
+ * 按个数加权随机抽取一个安全序列，每个安全序列被抽中的概率相同。
+ * 必须在seq_enum_count之后、且没有overflow时调用。
+ */
+void seq_enum_sample(SeqEnum* e, int* out, unsigned* seed)
+{
+    Banker* b = e->b;
+    int p = b->p;
+    int* avail = alloc_ints(b->stride);
+    memset(e->S, 0, e->W * sizeof(unsigned long long));
+    memcpy(avail, b->v, b->stride * sizeof(int));
+    for(int done = 0; done < p; ) {
+        double* tot = seq_find(e, e->S);
+        if(tot == NULL) {  //剩下的进程都能满足，随机排列
+            int n = done;
+            for(int i = 0; i < p; i++)
+                if(!SEQ_IN(e->S, i)) out[n++] = i;
+            for(int k = p - 1; k > done; k--) {
+                int u = done + rand_r(seed) % (k - done + 1), t = out[k];
+                out[k] = out[u];
+                out[u] = t;
+            }
+            break;
+        }
+        double x = (double)rand_r(seed) / ((double)RAND_MAX + 1) * *tot;
+        int pick = -1;
+        for(int i = 0; i < p; i++) {
+            if(SEQ_IN(e->S, i) || !vec_le(ROW(b,need,i), avail, b->stride)) continue;
+            SEQ_FLIP(e->S, i);
+            double* c = seq_find(e, e->S);
+            double w = c ? *c : e->fact[p - done - 1];
+            SEQ_FLIP(e->S, i);
+            if(w <= 0) continue;  //从这里走不通，不能选
+            pick = i;             //舍入误差让x落在最后时，取最后一个计数非0的进程
+            if(x < w) break;
+            x -= w;
+        }
+        out[done++] = pick;
+        SEQ_FLIP(e->S, pick);
+        vec_add(avail, ROW(b,a,pick), b->stride);
+    }
+    free(avail);
+}
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void bench_simd()  //比较标量与AVX2的仍需-可用比较和累加
+{
+    const int ROWS = 1024;
+    int widths[] = { 8, 32, 128, 512, 2048, 8192 };
+    printf("资源数\t标量比较(ns/行)\tAVX2比较(ns/行)\t标量累加(ns/行)\tAVX2累加(ns/行)\n");
+    if(!__builtin_cpu_supports("avx2"))
+        printf("(CPU不支持AVX2，两列结果相同)\n");
+    simd_init();
+    for(int w = 0; w < (int)(sizeof(widths) / sizeof(widths[0])); w++) {
+        int n = widths[w];
+        int* rows = alloc_ints((size_t)ROWS * n);
+        int* curV = alloc_ints(n);
+        srand(n);
+        for(int j = 0; j < n; j++) curV[j] = 1000;
+        for(size_t k = 0; k < (size_t)ROWS * n; k++)
+            rows[k] = rand() % 1000;  //全部可满足，比较必须走完整行
+        int reps = 4000000 / n + 1;
+        double t[4];
+        int (*le[2])(const int*, const int*, int) = { vec_le_scalar, vec_le };
+        void (*add[2])(int*, const int*, int) = { vec_add_scalar, vec_add };
+        volatile int sink = 0;
+        for(int v = 0; v < 2; v++) {
+            double t0 = now_sec();
+            for(int it = 0; it < reps; it++)
+                sink += le[v](rows + (size_t)(it % ROWS) * n, curV, n);
+            t[v] = (now_sec() - t0) * 1e9 / reps;
+            t0 = now_sec();
+            for(int it = 0; it < reps; it++)
+                add[v](curV, rows + (size_t)(it % ROWS) * n, n);
+            t[v + 2] = (now_sec() - t0) * 1e9 / reps;
+        }
+        printf("%d\t%.1f\t\t%.1f\t\t%.1f\t\t%.1f\n", n, t[0], t[1], t[2], t[3]);
+        free(rows);
+        free(curV);
+    }
+}
+
+/*
+ * 死锁检测模式：不需要事先声明最大需求。
+ * 维护等待图：进程W阻塞在资源j上、进程H占有j时有边W->H，边上记录
+ * 这样的资源有几种。每次请求、归还都只增删受影响的边，并用
+ * Pearce-Kelly动态拓扑序维护图的拓扑序：插入边x->y时若ord[x] < ord[y]
+ * 什么都不用做，否则只在ord[y]..ord[x]之间搜索并重排受影响的结点，
+ * 搜索中回到x就是出现了环。
+ * 资源都只有一个实例时有环即死锁；有多实例资源时再用检测算法确认。
+ * 有环之后把环上的结点合并成强连通分量，拓扑序改为分量之间的序，
+ * 同一分量的结点在序中相邻：插入成环的边时只重排ord[y]..ord[x]之间的结点，
+ * 删去分量内部的边时只在这个分量内重新求强连通分量。
+ */
+typedef struct AdjList {
+    int *to, *cnt;  //cnt只用于出边：这条等待边由几种资源造成
+    int n, cap;
+} AdjList;
+
+typedef struct Detector {
+    int p, r;
+    int *inst, *avail;     //每个资源的实例总数、可用数
+    int *alloc, *want;     //已分配、阻塞中的请求，p*r
+    int *waiting;          //进程是否阻塞
+    int *hl, *hn, *hpos;   //每个资源的占有者表：hl[j*p+k]，个数hn[j]，进程在表中的位置hpos[i*r+j]
+    int *wl, *wn, *wpos;   //每个资源的等待者表
+    AdjList *out, *in;
+    int *ord, *at;         //拓扑序：ord[i]为结点i的序号，at[k]为序号k上的结点
+    int *comp, *csize;     //强连通分量：comp[i]为i所在分量的代表结点，csize[代表]为分量大小
+    int *mark, *bmark, *parent, *stack, *bufF, *bufB, *slots;
+    int *dfn, *low, *iter; //拆分分量时Tarjan算法用
+    int *wreq, *touched;   //dl_wake、dl_release的临时行
+    int stamp;
+    int cyclic;            //不止一个结点的强连通分量（环）的个数
+    int *cycle, cyclen;    //最近发现的环
+} Detector;
+
+#define DL_GRANTED 0
+#define DL_BLOCKED 1
+#define DL_DEADLOCK 2
+#define DL_CYCLE 3     //有等待环，但多实例资源下并未死锁
+#define DL_ERROR 4
+
+static void adj_add(AdjList* l, int v, int c)
+{
+    if(l->n == l->cap) {
+        l->cap = l->cap ? 2 * l->cap : 4;
+        l->to = realloc(l->to, l->cap * sizeof(int));
+        l->cnt = realloc(l->cnt, l->cap * sizeof(int));
+    }
+    l->to[l->n] = v;
+    l->cnt[l->n++] = c;
+}
+
+static int adj_find(const AdjList* l, int v)
+{
+    for(int k = 0; k < l->n; k++)
+        if(l->to[k] == v) return k;
+    return -1;
+}
+
+static void adj_del(AdjList* l, int k)
+{
+    l->n--;
+    l->to[k] = l->to[l->n];
+    l->cnt[k] = l->cnt[l->n];
+}
+
+Detector* dl_new(int p, int r, const int* inst)
+{
+    Detector* d = calloc(1, sizeof(Detector));
+    d->p = p;
+    d->r = r;
+    d->inst = malloc(r * sizeof(int));
+    d->avail = malloc(r * sizeof(int));
+    memcpy(d->inst, inst, r * sizeof(int));
+    memcpy(d->avail, inst, r * sizeof(int));
+    d->alloc = calloc((size_t)p * r, sizeof(int));
+    d->want = calloc((size_t)p * r, sizeof(int));
+    d->waiting = calloc(p, sizeof(int));
+    d->hl = malloc((size_t)p * r * sizeof(int));
+    d->wl = malloc((size_t)p * r * sizeof(int));
+    d->hpos = malloc((size_t)p * r * sizeof(int));
+    d->wpos = malloc((size_t)p * r * sizeof(int));
+    d->hn = calloc(r, sizeof(int));
+    d->wn = calloc(r, sizeof(int));
+    d->out = calloc(p, sizeof(AdjList));
+    d->in = calloc(p, sizeof(AdjList));
+    d->ord = malloc(p * sizeof(int));
+    d->at = malloc(p * sizeof(int));
+    d->comp = malloc(p * sizeof(int));
+    d->csize = malloc(p * sizeof(int));
+    d->mark = calloc(p, sizeof(int));
+    d->bmark = calloc(p, sizeof(int));
+    d->parent = malloc(p * sizeof(int));
+    d->stack = malloc(p * sizeof(int));
+    d->bufF = malloc(p * sizeof(int));
+    d->bufB = malloc(p * sizeof(int));
+    d->slots = malloc(2 * p * sizeof(int));
+    d->dfn = malloc(p * sizeof(int));
+    d->low = malloc(p * sizeof(int));
+    d->iter = malloc(p * sizeof(int));
+    d->wreq = malloc(r * sizeof(int));
+    d->touched = malloc(r * sizeof(int));
+    d->cycle = malloc((p + 1) * sizeof(int));
+    for(int i = 0; i < p; i++) {
+        d->ord[i] = d->at[i] = d->comp[i] = i;
+        d->csize[i] = 1;
+    }
+    return d;
+}
+
+void dl_free(Detector* d)
+{
+    for(int i = 0; i < d->p; i++) {
+        free(d->out[i].to); free(d->out[i].cnt);
+        free(d->in[i].to); free(d->in[i].cnt);
+    }
+    free(d->inst); free(d->avail); free(d->alloc); free(d->want); free(d->waiting);
+    free(d->hl); free(d->wl); free(d->hpos); free(d->wpos); free(d->hn); free(d->wn);
+    free(d->out); free(d->in); free(d->ord); free(d->at); free(d->comp); free(d->csize);
+    free(d->mark); free(d->bmark); free(d->parent);
+    free(d->stack); free(d->bufF); free(d->bufB); free(d->slots);
+    free(d->dfn); free(d->low); free(d->iter); free(d->wreq); free(d->touched); free(d->cycle);
+    free(d);
+}
+
+static void list_add(int* l, int* n, int* pos, int j, int i, int p, int r)
+{
+    l[(size_t)j * p + n[j]] = i;
+    pos[(size_t)i * r + j] = n[j]++;
+}
+
+static void list_del(int* l, int* n, int* pos, int j, int i, int p, int r)
+{
+    int k = pos[(size_t)i * r + j], last = l[(size_t)j * p + --n[j]];
+    l[(size_t)j * p + k] = last;
+    pos[(size_t)last * r + j] = k;
+}
+
+static int dl_stamp(Detector* d)  //取一个新的标记值，快溢出时清零
+{
+    if(d->stamp >= 0x3fffffff) {
+        memset(d->mark, 0, d->p * sizeof(int));
+        memset(d->bmark, 0, d->p * sizeof(int));
+        d->stamp = 0;
+    }
+    return ++d->stamp;
+}
+
+static int blk_lo(const Detector* d, int i)  //i所在分量在拓扑序中的第一个序号
+{
+    int k = d->ord[i];
+    while(k > 0 && d->comp[d->at[k - 1]] == d->comp[i]) k--;
+    return k;
+}
+
+static int blk_hi(const Detector* d, int i)  //i所在分量在拓扑序中的最后一个序号
+{
+    int k = d->ord[i];
+    while(k + 1 < d->p && d->comp[d->at[k + 1]] == d->comp[i]) k++;
+    return k;
+}
+
+static void dl_reach(Detector* d, int from, int target)  //在同一分量内找from到target的路径
+{
+    int top = 0, st = dl_stamp(d), c = d->comp[from];
+    d->stack[top++] = from;
+    d->mark[from] = st;
+    d->parent[from] = -1;
+    while(top > 0) {
+        int u = d->stack[--top];
+        for(int e = 0; e < d->out[u].n; e++) {
+            int w = d->out[u].to[e];
+            if(d->mark[w] == st || d->comp[w] != c) continue;
+            d->mark[w] = st;
+            d->parent[w] = u;
+            if(w == target) return;
+            d->stack[top++] = w;
+        }
+    }
+}
+
+static void dl_save_cycle(Detector* d, int x, int y)  //由parent还原环x->y->...->x
+{
+    int n = 0;
+    for(int u = d->parent[x]; u != -1 && u != y; u = d->parent[u])
+        d->cycle[n++] = u;
+    d->cycle[n++] = y;
+    d->cycle[n++] = x;
+    for(int k = 0; k < n / 2; k++) {  //反转为从x出发
+        int t = d->cycle[k];
+        d->cycle[k] = d->cycle[n - 1 - k];
+        d->cycle[n - 1 - k] = t;
+    }
+    d->cycle[n] = x;
+    d->cyclen = n + 1;
+}
+
+static int cmp_ord_ctx(const void* x, const void* y, void* ctx)
+{
+    const int* ord = ctx;
+    return ord[*(const int*)x] - ord[*(const int*)y];
+}
+
+static int cmp_int(const void* x, const void* y)
+{
+    return *(const int*)x - *(const int*)y;
+}
+
+/*
+ * 重排[lb, ub]这一段：只能到达x的结点（B）在前，新的分量（F∩B）其次，
+ * 无关的结点再次，只能由y到达的结点（F）最后，各组保持原有次序。
+ * B对区间内的前驱封闭、F对区间内的后继封闭，所以各组之间没有反向的边，
+ * 原有分量整个落在同一组里，仍然相邻。
+ */
+static void pk_region(Detector* d, int lb, int ub, int fs, int bs, int merged)
+{
+    int n = 0;
+    for(int g = 0; g < 4; g++)
+        for(int k = lb; k <= ub; k++) {
+            int u = d->at[k], inF = d->mark[u] == fs, inB = d->bmark[u] == bs;
+            if((inB && !inF ? 0 : inB ? 1 : !inF ? 2 : 3) == g) d->slots[n++] = u;
+        }
+    for(int k = 0; k < n; k++) {
+        d->ord[d->slots[k]] = lb + k;
+        d->at[lb + k] = d->slots[k];
+    }
+    if(!merged) return;
+    int c = -1, size = 0;  //F∩B合并成一个分量，代表结点取其中第一个
+    for(int k = 0; k < n; k++) {
+        int u = d->slots[k];
+        if(d->mark[u] != fs || d->bmark[u] != bs) continue;
+        if(d->comp[u] == u && d->csize[u] > 1) d->cyclic--;
+        if(c < 0) c = u;
+        d->comp[u] = c;
+        size++;
+    }
+    d->csize[c] = size;
+    d->cyclic++;
+}
+
+static int pk_insert(Detector* d, int x, int y)  //插入边x->y，成环返回1
+{
+    if(d->comp[x] == d->comp[y]) {  //分量内部的边，环本来就有
+        dl_reach(d, y, x);
+        dl_save_cycle(d, x, y);
+        return 1;
+    }
+    int lb = blk_lo(d, y), ub = blk_hi(d, x);
+    if(lb > ub) return 0;
+    int nf = 0, nb = 0, top = 0, found = 0;
+    int fs = dl_stamp(d), bs = dl_stamp(d);
+    d->stack[top++] = y;
+    d->mark[y] = fs;
+    d->parent[y] = -1;
+    while(top > 0) {  //从y向前搜索ord不超过ub的结点
+        int u = d->stack[--top];
+        d->bufF[nf++] = u;
+        for(int e = 0; e < d->out[u].n; e++) {
+            int w = d->out[u].to[e];
+            if(d->mark[w] != fs && d->ord[w] <= ub) {
+                d->mark[w] = fs;
+                d->parent[w] = u;
+                d->stack[top++] = w;
+                found |= w == x;
+            }
+        }
+    }
+    d->stack[top++] = x;
+    d->bmark[x] = bs;
+    while(top > 0) {  //从x向后搜索ord不小于lb的结点
+        int u = d->stack[--top];
+        d->bufB[nb++] = u;
+        for(int e = 0; e < d->in[u].n; e++) {
+            int w = d->in[u].to[e];
+            if(d->bmark[w] != bs && d->ord[w] >= lb) {
+                d->bmark[w] = bs;
+                d->stack[top++] = w;
+            }
+        }
+    }
+    if(found || d->cyclic) {
+        if(found) dl_save_cycle(d, x, y);
+        pk_region(d, lb, ub, fs, bs, found);
+        return found;
+    }
+    //没有环时各结点自成分量：受影响结点原有的序号重新分配，先后向集合，再前向集合，各自保持原有次序
+    qsort_r(d->bufB, nb, sizeof(int), cmp_ord_ctx, d->ord);
+    qsort_r(d->bufF, nf, sizeof(int), cmp_ord_ctx, d->ord);
+    for(int k = 0; k < nb; k++) d->slots[k] = d->ord[d->bufB[k]];
+    for(int k = 0; k < nf; k++) d->slots[nb + k] = d->ord[d->bufF[k]];
+    qsort(d->slots, nb + nf, sizeof(int), cmp_int);
+    for(int k = 0; k < nb; k++) d->ord[d->bufB[k]] = d->slots[k];
+    for(int k = 0; k < nf; k++) d->ord[d->bufF[k]] = d->slots[nb + k];
+    for(int k = 0; k < nb + nf; k++) d->at[d->slots[k]] = k < nb ? d->bufB[k] : d->bufF[k - nb];
+    return 0;
+}
+
+/*
+ * 删去分量c内部的边后，用Tarjan算法在c内重新求强连通分量。
+ * 分量按逆拓扑序完成，依次占用c原来那一段序号的末尾。
+ */
+static void dl_split(Detector* d, int c)
+{
+    int lo = blk_lo(d, c), n = d->csize[c], hi = lo + n, idx = 0;
+    int sp = 0, top = 0, st = dl_stamp(d);
+    memcpy(d->bufB, d->at + lo, n * sizeof(int));
+    for(int k = 0; k < n; k++) d->dfn[d->bufB[k]] = -1;
+    d->cyclic--;
+    for(int k = 0; k < n; k++) {
+        int s0 = d->bufB[k];
+        if(d->dfn[s0] >= 0) continue;
+        d->dfn[s0] = d->low[s0] = idx++;
+        d->iter[s0] = 0;
+        d->stack[sp++] = s0;
+        d->bufF[top++] = s0;
+        d->mark[s0] = st;
+        while(sp > 0) {
+            int u = d->stack[sp - 1];
+            if(d->iter[u] < d->out[u].n) {
+                int w = d->out[u].to[d->iter[u]++];
+                if(d->comp[w] != c) continue;
+                if(d->dfn[w] < 0) {
+                    d->dfn[w] = d->low[w] = idx++;
+                    d->iter[w] = 0;
+                    d->stack[sp++] = w;
+                    d->bufF[top++] = w;
+                    d->mark[w] = st;
+                }
+                else if(d->mark[w] == st && d->dfn[w] < d->low[u]) d->low[u] = d->dfn[w];
+                continue;
+            }
+            sp--;
+            if(sp > 0 && d->low[u] < d->low[d->stack[sp - 1]]) d->low[d->stack[sp - 1]] = d->low[u];
+            if(d->low[u] != d->dfn[u]) continue;
+            int size = 0, w;
+            do {  //弹出以u为根的分量，放在剩余序号的最后
+                w = d->bufF[--top];
+                d->mark[w] = 0;
+                d->comp[w] = u;
+                d->ord[w] = --hi;
+                d->at[hi] = w;
+                size++;
+            } while(w != u);
+            d->csize[u] = size;
+            if(size > 1) d->cyclic++;
+        }
+    }
+}
+
+static int edge_inc(Detector* d, int u, int v)  //等待边u->v的计数加一，新边成环返回1
+{
+    int k = adj_find(&d->out[u], v);
+    if(k >= 0) {
+        d->out[u].cnt[k]++;
+        return 0;
+    }
+    adj_add(&d->out[u], v, 1);
+    adj_add(&d->in[v], u, 0);
+    return pk_insert(d, u, v);
 }
 
+static void edge_dec(Detector* d, int u, int v)
+{
+    int k = adj_find(&d->out[u], v);
+    if(--d->out[u].cnt[k] > 0) return;
+    adj_del(&d->out[u], k);
+    adj_del(&d->in[v], adj_find(&d->in[v], u));
+    if(d->comp[u] == d->comp[v]) dl_split(d, d->comp[u]);  //分量之间的边删去后拓扑序仍然有效
+}
+
+static void dl_grant(Detector* d, int i, const int* req)  //把req分给进程i
+{
+    int p = d->p, r = d->r;
+    int* ai = d->alloc + (size_t)i * r;
+    for(int j = 0; j < r; j++) {
+        if(req[j] == 0) continue;
+        d->avail[j] -= req[j];
+        if(ai[j] == 0) {  //i成为j的占有者，j的等待者都要等i
+            list_add(d->hl, d->hn, d->hpos, j, i, p, r);
+            for(int k = 0; k < d->wn[j]; k++)
+                edge_inc(d, d->wl[(size_t)j * p + k], i);  //i没有出边，不会成环
+        }
+        ai[j] += req[j];
+    }
+}
+
+static void dl_unwait(Detector* d, int i)  //撤销进程i的等待
+{
+    int p = d->p, r = d->r;
+    int* wi = d->want + (size_t)i * r;
+    for(int j = 0; j < r; j++) {
+        if(wi[j] == 0) continue;
+        list_del(d->wl, d->wn, d->wpos, j, i, p, r);
+        for(int k = 0; k < d->hn[j]; k++)
+            if(d->hl[(size_t)j * p + k] != i) edge_dec(d, i, d->hl[(size_t)j * p + k]);
+    }
+    d->waiting[i] = 0;
+}
+
+static int req_fits(const Detector* d, const int* req)
+{
+    for(int j = 0; j < d->r; j++)
+        if(req[j] > d->avail[j]) return 0;
+    return 1;
+}
+
+static void dl_wake(Detector* d, const int* touched)  //资源增加后唤醒能满足的等待者
+{
+    int p = d->p, r = d->r, progress = 1;
+    while(progress) {
+        progress = 0;
+        for(int j = 0; j < r; j++) {
+            if(!touched[j]) continue;
+            for(int k = 0; k < d->wn[j]; k++) {
+                int w = d->wl[(size_t)j * p + k];
+                int* ww = d->want + (size_t)w * r;
+                if(!req_fits(d, ww)) continue;
+                memcpy(d->wreq, ww, r * sizeof(int));
+                dl_unwait(d, w);
+                memset(ww, 0, r * sizeof(int));
+                dl_grant(d, w, d->wreq);
+                progress = 1;
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * 用检测算法确认死锁：没有占用资源的进程视为已完成，其余进程
+ * 若阻塞请求能被当前可用量满足就可以完成并归还。最后没完成的进程死锁。
+ * 结果写入dead[]，返回死锁进程数。O(p*p*r)，只在发现环时调用。
+ */
+int dl_detect_full(Detector* d, int* dead)
+{
+    int p = d->p, r = d->r, n = 0;
+    int* work = malloc(r * sizeof(int));
+    int* fin = calloc(p, sizeof(int));
+    memcpy(work, d->avail, r * sizeof(int));
+    for(int i = 0; i < p; i++) {
+        int j;
+        for(j = 0; j < r && d->alloc[(size_t)i * r + j] == 0; j++);
+        fin[i] = j == r;
+    }
+    for(int progress = 1; progress; ) {
+        progress = 0;
+        for(int i = 0; i < p; i++) {
+            if(fin[i]) continue;
+            int j, *wi = d->want + (size_t)i * r;
+            for(j = 0; j < r && wi[j] <= work[j]; j++);
+            if(j < r) continue;
+            for(j = 0; j < r; j++) work[j] += d->alloc[(size_t)i * r + j];
+            fin[i] = progress = 1;
+        }
+    }
+    for(int i = 0; i < p; i++)
+        if(!fin[i]) dead[n++] = i;
+    free(work);
+    free(fin);
+    return n;
+}
+
+/*
+ * 发现等待环d->cycle后判断是否真的死锁。环上每条边u->v都有一个单实例资源
+ * 是u在等、v占有的，环上的进程就只能互相等对方归还，一定死锁；否则用检测算法确认。
+ */
+static int dl_confirm(Detector* d)
+{
+    int k, r = d->r;
+    for(k = 0; k + 1 < d->cyclen; k++) {
+        int j, *wu = d->want + (size_t)d->cycle[k] * r, *av = d->alloc + (size_t)d->cycle[k + 1] * r;
+        for(j = 0; j < r && !(wu[j] > 0 && av[j] > 0 && d->inst[j] == 1); j++);
+        if(j == r) break;
+    }
+    if(k + 1 == d->cyclen) return DL_DEADLOCK;
+    int* dead = malloc(d->p * sizeof(int));
+    int n = dl_detect_full(d, dead);
+    free(dead);
+    return n > 0 ? DL_DEADLOCK : DL_CYCLE;
+}
+
+int dl_request(Detector* d, int i, const int* req)  //进程i申请req
+{
+    int p = d->p, r = d->r, res = DL_BLOCKED;
+    if(i < 0 || i >= p || d->waiting[i]) return DL_ERROR;
+    for(int j = 0; j < r; j++)
+        if(req[j] < 0 || d->alloc[(size_t)i * r + j] + req[j] > d->inst[j]) return DL_ERROR;
+    if(req_fits(d, req)) {
+        dl_grant(d, i, req);
+        return DL_GRANTED;
+    }
+    int* wi = d->want + (size_t)i * r;
+    memcpy(wi, req, r * sizeof(int));
+    d->waiting[i] = 1;
+    for(int j = 0; j < r; j++) {
+        if(req[j] == 0) continue;
+        list_add(d->wl, d->wn, d->wpos, j, i, p, r);
+        for(int k = 0; k < d->hn[j]; k++) {
+            int h = d->hl[(size_t)j * p + k];
+            if(h != i && edge_inc(d, i, h)) res = DL_DEADLOCK;
+        }
+    }
+    if(res == DL_DEADLOCK) res = dl_confirm(d);
+    return res;
+}
+
+int dl_release(Detector* d, int i, const int* rel)  //进程i归还rel
+{
+    int p = d->p, r = d->r;
+    if(i < 0 || i >= p || d->waiting[i]) return DL_ERROR;
+    int* ai = d->alloc + (size_t)i * r;
+    for(int j = 0; j < r; j++)
+        if(rel[j] < 0 || rel[j] > ai[j]) return DL_ERROR;
+    int* touched = d->touched;
+    memset(touched, 0, r * sizeof(int));
+    for(int j = 0; j < r; j++) {
+        if(rel[j] == 0) continue;
+        ai[j] -= rel[j];
+        d->avail[j] += rel[j];
+        touched[j] = 1;
+        if(ai[j] == 0) {  //i不再占有j
+            list_del(d->hl, d->hn, d->hpos, j, i, p, r);
+            for(int k = 0; k < d->wn[j]; k++)
+                edge_dec(d, d->wl[(size_t)j * p + k], i);
+        }
+    }
+    dl_wake(d, touched);
+    return DL_GRANTED;
+}
+
+int dl_abort(Detector* d, int i)  //撤销进程i：取消等待并归还全部资源
+{
+    if(i < 0 || i >= d->p) return DL_ERROR;
+    if(d->waiting[i]) {
+        dl_unwait(d, i);
+        memset(d->want + (size_t)i * d->r, 0, d->r * sizeof(int));
+    }
+    int* rel = malloc(d->r * sizeof(int));
+    memcpy(rel, d->alloc + (size_t)i * d->r, d->r * sizeof(int));
+    dl_release(d, i, rel);
+    free(rel);
+    return DL_GRANTED;
+}
+
+void detect_mode()  //./banker detect，从输入读取操作
+{
+    int p, r;
+    printf("请输入进程数p\n");
+    scanf("%d",&p);
+    printf("请输入资源数r\n");
+    scanf("%d",&r);
+    if(p <= 0 || r <= 0) {
+        printf("进程数和资源数必须为正数!\n");
+        return;
+    }
+    int* vec = malloc(r * sizeof(int));
+    printf("请分别输入每个资源的实例总数\n");
+    for(int j = 0; j < r; j++) scanf("%d",&vec[j]);
+    Detector* d = dl_new(p, r, vec);
+    printf("请输入操作: q 进程 各资源数目(申请)  l 进程 各资源数目(归还)  a 进程(撤销)  e(退出)\n");
+    char op[8];
+    int i;
+    while(scanf("%7s", op) == 1 && op[0] != 'e') {
+        if(scanf("%d",&i) != 1) break;
+        int res;
+        if(op[0] == 'a') res = dl_abort(d, i);
+        else {
+            for(int j = 0; j < r; j++) scanf("%d",&vec[j]);
+            res = op[0] == 'q' ? dl_request(d, i, vec) : dl_release(d, i, vec);
+        }
+        switch(res) {
+        case DL_GRANTED: printf("进程%d操作成功\n", i); break;
+        case DL_BLOCKED: printf("进程%d阻塞等待\n", i); break;
+        case DL_ERROR: printf("操作无效!\n"); break;
+        default:
+            printf(res == DL_DEADLOCK ? "检测到死锁：" : "出现等待环（多实例资源，未死锁）：");
+            for(int k = 0; k < d->cyclen; k++)
+                printf(k ? " -> P%d" : "P%d", d->cycle[k]);
+            printf("\n");
+        }
+    }
+    free(vec);
+    dl_free(d);
+}
+
+/*
+ * 增量安全检查
+ * 进程num在缓存序列中的位置为q，给它分配req后：
+ *   q之前的位置可用量都少了req，需要 req <= min(slack_k), k<q；
+ *   位置q可用量和仍需量同时少了req，松弛量不变；
+ *   q之后的位置可用量不变（num完成时归还的总量不变）。
+ * 所以只需比较req与前缀最小松弛量，通过后给前缀整体减req。
+ * 进程完成释放资源后，它之前的位置可用量增加a_i，原位置作废，
+ * 它以最大需求c_i排到序列末尾，末尾的可用量恒为tot。
+ * 前缀最小值与前缀加法按块做，代价O((p/blk + blk)*r)。
+ */
+static int* seq_slack(Banker* b, int k)
+{
+    return b->slack + (size_t)k * b->stride;
+}
+
+static void blk_rebuild(Banker* b, int k)  //重新计算第k块的最小松弛量
+{
+    int* m = ROW(b,bmin,k);
+    int lo = k * b->blk, hi = lo + b->blk < b->seqlen ? lo + b->blk : b->seqlen;
+    for(int j = 0; j < b->stride; j++) m[j] = GHOST_SLACK;
+    for(int t = lo; t < hi; t++)
+        vec_min(m, seq_slack(b, t), b->stride);
+}
+
+void cache_build(Banker* b, const int* order)  //由安全序列order重建缓存，O(p*r)
+{
+    int p = b->p;
+    if(b->seq == NULL) {
+        b->cap = 2 * p;
+        b->blk = 8;
+        while(b->blk * b->blk < b->cap) b->blk++;
+        int nblk = (b->cap + b->blk - 1) / b->blk;
+        b->seq = alloc_ints(b->cap);
+        b->pos = alloc_ints(p);
+        b->slack = alloc_ints((size_t)b->cap * b->stride);
+        b->bmin = alloc_ints((size_t)nblk * b->stride);
+        b->blazy = alloc_ints((size_t)nblk * b->stride);
+    }
+    if(order != b->seq)
+        memcpy(b->seq, order, p * sizeof(int));
+    memset(b->blazy, 0, (size_t)((b->cap + b->blk - 1) / b->blk) * b->stride * sizeof(int));
+    memcpy(b->tot, b->v, b->stride * sizeof(int));
+    for(int k = 0; k < p; k++) {
+        int i = b->seq[k];
+        int* sl = seq_slack(b, k);
+        memcpy(sl, b->tot, b->stride * sizeof(int));
+        vec_sub(sl, ROW(b,need,i), b->stride);
+        vec_add(b->tot, ROW(b,a,i), b->stride);
+        b->pos[i] = k;
+    }
+    b->seqlen = p;
+    for(int k = 0; k * b->blk < p; k++)
+        blk_rebuild(b, k);
+    b->path_ok = 1;
+}
+
+void fill_path(Banker* b)  //把缓存序列中有效的进程写回path
+{
+    int n = 0;
+    for(int k = 0; k < b->seqlen; k++)
+        if(b->seq[k] >= 0) b->path[n++] = b->seq[k];
+}
+
+static int prefix_ok(Banker* b, int q, const int* req, int* tmp)  //req <= slack_k对所有k<q成立
+{
+    int kb = q / b->blk;
+    for(int k = 0; k < kb; k++) {
+        memcpy(tmp, ROW(b,bmin,k), b->stride * sizeof(int));
+        vec_add(tmp, ROW(b,blazy,k), b->stride);
+        if(!vec_le(req, tmp, b->stride)) return 0;
+    }
+    for(int t = kb * b->blk; t < q; t++) {
+        memcpy(tmp, seq_slack(b, t), b->stride * sizeof(int));
+        vec_add(tmp, ROW(b,blazy,kb), b->stride);
+        if(!vec_le(req, tmp, b->stride)) return 0;
+    }
+    return 1;
+}
+
+static void prefix_add(Banker* b, int q, const int* d, int sign)  //slack_k += sign*d，k<q
+{
+    void (*op)(int*, const int*, int) = sign > 0 ? vec_add : vec_sub;
+    int kb = q / b->blk;
+    for(int k = 0; k < kb; k++)
+        op(ROW(b,blazy,k), d, b->stride);
+    if(kb * b->blk == q) return;
+    for(int t = kb * b->blk; t < q; t++)
+        op(seq_slack(b, t), d, b->stride);
+    blk_rebuild(b, kb);
+}
+
+static void cache_release(Banker* b, int i)  //进程i完成并释放资源后更新缓存
+{
+    int q = b->pos[i];
+    prefix_add(b, q + 1, ROW(b,a,i), 1);
+    b->seq[q] = -1;
+    for(int j = 0; j < b->stride; j++) seq_slack(b, q)[j] = GHOST_SLACK;
+    blk_rebuild(b, q / b->blk);
+    if(!vec_le(ROW(b,c,i), b->tot, b->stride)) {  //最大需求超过资源总量，只能重新检查
+        b->path_ok = 0;
+        return;
+    }
+    int k = b->seqlen++, kb = k / b->blk;
+    int* sl = seq_slack(b, k);
+    memcpy(sl, b->tot, b->stride * sizeof(int));
+    vec_sub(sl, ROW(b,c,i), b->stride);
+    vec_sub(sl, ROW(b,blazy,kb), b->stride);
+    if(k % b->blk == 0) memcpy(ROW(b,bmin,kb), sl, b->stride * sizeof(int));
+    else vec_min(ROW(b,bmin,kb), sl, b->stride);
+    b->seq[k] = i;
+    b->pos[i] = k;
+}
+
+static void release_done(Banker* b, int i)  //已满足最大需求的进程释放资源
+{
+    int* ni = ROW(b,need,i);
+    int* ai = ROW(b,a,i);
+    int j;
+    for(j = 0; j < b->r; j++)
+        if(ni[j] != 0) return;
+    for(j = 0; j < b->r; j++)
+        if(ai[j] != 0) break;
+    if(j == b->r) return;  //没有占用资源
+    if(b->path_ok && b->seqlen == b->cap) {  //序列已满，压缩掉作废的位置，均摊O(r)
+        fill_path(b);
+        cache_build(b, b->path);
+    }
+    if(b->path_ok) cache_release(b, i);
+    vec_add(b->v, ai, b->stride);
+    memset(ai, 0, b->stride * sizeof(int));
+    update_need(b, i);
+}
+
+/*
+ * 为进程num分配req，成功后已满足最大需求的进程释放资源。不做输入输出。
+ * 缓存有效时先做增量检查，不通过或缓存无效时才调用完整的safe()。
+ */
+int bank_decide(Banker* b, int num, const int* req)
+{
+    int v = bank_check(b, num, req, b->tmp);
+    if(v == BANK_OVER_AVAIL || v == BANK_OVER_NEED || v == BANK_INVALID) return v;
+    return bank_commit(b, num, req, v == BANK_OK);
+}
+
+static int row_nonneg(const int* x, int r)  //x[j] >= 0对所有j成立
+{
+    for(int j = 0; j < r; j++)
+        if(x[j] < 0) return 0;
+    return 1;
+}
+
+/*
+ * 只读的检查：返回BANK_INVALID/BANK_OVER_AVAIL/BANK_OVER_NEED，增量检查通过返回BANK_OK，
+ * 否则返回BANK_NEED_FULL。不修改状态，tmp为调用者的临时行。
+ */
+int bank_check(Banker* b, int num, const int* req, int* tmp)
+{
+    if(!row_nonneg(req, b->r)) return BANK_INVALID;
+    if(!vec_le(req, b->v, b->stride)) return BANK_OVER_AVAIL;
+    if(!vec_le(req, ROW(b,need,num), b->stride)) return BANK_OVER_NEED;
+    if(b->path_ok && prefix_ok(b, b->pos[num], req, tmp)) return BANK_OK;
+    return BANK_NEED_FULL;
+}
+
+//执行分配。checked表示已在当前状态上通过了增量检查，否则做完整检查
+int bank_commit(Banker* b, int num, const int* req, int checked)
+{
+    int* a = ROW(b,a,num);
+    int* need = ROW(b,need,num);
+    int ok = checked;
+    vec_add(a, req, b->stride);
+    vec_sub(need, req, b->stride);
+    vec_sub(b->v, req, b->stride);
+    if(ok)
+        prefix_add(b, b->pos[num], req, -1);
+    else if(safe(b))
+        cache_build(b, b->path);
+    else {
+        vec_sub(a, req, b->stride);
+        vec_add(need, req, b->stride);
+        vec_add(b->v, req, b->stride);
+        return BANK_UNSAFE;
+    }
+    if(!b->swept) {
+        for(int i = 0; i < b->p; i++)
+            release_done(b, i);
+        b->swept = 1;
+    }
+    else release_done(b, num);
+    return BANK_OK;
+}
+
+/*
+ * 批量分配：按申请总量从小到大依次尝试，尽量多地接纳请求。
+ * 各请求共用增量检查的缓存，只有增量检查不通过时才做完整检查。
+ * 被拒绝的请求在后面的请求让进程完成、释放资源后还可能通过，
+ * 所以只要上一轮有新的接纳，就对拒绝的请求再试一轮。
+ * verdict[k]为第k个请求的BANK_*结果，返回接纳的个数。不做输入输出。
+ */
+typedef struct BatchItem {
+    long long total;  //申请总量
+    int idx;
+} BatchItem;
+
+static int cmp_batch(const void* x, const void* y)
+{
+    const BatchItem *u = x, *w = y;
+    if(u->total != w->total) return u->total < w->total ? -1 : 1;
+    return u->idx - w->idx;
+}
+
+int bank_batch(Banker* b, const BankRequest* reqs, int n, int* verdict)
+{
+    BatchItem* items = malloc((n ? n : 1) * sizeof(BatchItem));
+    int m = 0, admitted = 0;
+    for(int k = 0; k < n; k++) {
+        if(reqs[k].num < 0 || reqs[k].num >= b->p) {
+            verdict[k] = BANK_BAD_PID;
+            continue;
+        }
+        long long total = 0;
+        for(int j = 0; j < b->r; j++) total += reqs[k].req[j];
+        items[m].total = total;
+        items[m++].idx = k;
+    }
+    qsort(items, m, sizeof(BatchItem), cmp_batch);
+    for(int pass = 0; pass < BATCH_PASSES && m > 0; pass++) {
+        int left = 0, got = 0;
+        for(int t = 0; t < m; t++) {
+            int k = items[t].idx;
+            verdict[k] = bank_decide(b, reqs[k].num, reqs[k].req);
+            if(verdict[k] == BANK_OK) got++;
+            else items[left++] = items[t];  //留到下一轮
+        }
+        admitted += got;
+        m = left;
+        if(got == 0) break;
+    }
+    free(items);
+    return admitted;
+}
+
+void bank_menu_batch(Banker* b)  //从输入读一批请求并批量分配
+{
+    int n;
+    printf("请输入请求个数\n");
+    if(scanf("%d",&n) != 1 || n <= 0) return;
+    printf("请输入每个请求：进程号 各资源的申请数目\n");
+    BankRequest* reqs = malloc(n * sizeof(BankRequest));
+    int* rows = alloc_ints((size_t)n * b->stride);
+    int* verdict = alloc_ints(n);
+    for(int k = 0; k < n; k++) {
+        int* row = rows + (size_t)k * b->stride;
+        scanf("%d",&reqs[k].num);
+        for(int j = 0; j < b->r; j++)
+            scanf("%d",&row[j]);
+        reqs[k].req = row;
+    }
+    int admitted = bank_batch(b, reqs, n, verdict);
+    const char* msg[] = { "成功", "超过已有资源", "超过所需最大值", "不安全", "数目为负", "进程号不存在" };
+    for(int k = 0; k < n; k++)
+        printf("请求%d（进程%d）：%s\n", k + 1, reqs[k].num, msg[verdict[k]]);
+    printf("共接纳%d/%d个请求\n", admitted, n);
+    free(reqs);
+    free(rows);
+    free(verdict);
+}
+
+//进程num主动归还rel，归还后的状态一定安全，缓存中num之前的位置可用量增加rel
+int bank_release(Banker* b, int num, const int* rel)
+{
+    if(!row_nonneg(rel, b->r)) return BANK_INVALID;
+    if(!vec_le(rel, ROW(b,a,num), b->stride)) return BANK_OVER_NEED;  //不能归还多于已分配的
+    if(b->path_ok)
+        prefix_add(b, b->pos[num], rel, 1);
+    vec_sub(ROW(b,a,num), rel, b->stride);
+    vec_add(ROW(b,need,num), rel, b->stride);
+    vec_add(b->v, rel, b->stride);
+    return BANK_OK;
+}
+
+/*
+ * 场景文件：与交互输入的顺序相同（p r R[] v[] c[][] a[][]），空白分隔，
+ * #到行尾为注释。整个文件mmap后直接扫描，不经过scanf。
+ * 快照文件：64字节文件头之后依次是R、v、c、a、need，每段按stride补齐
+ * 并按64字节对齐，与内存中的布局完全相同；加载时MAP_PRIVATE映射，
+ * Banker的这几个指针直接指向映射，修改只写到私有页，不影响文件。
+ */
+#define SNAP_MAGIC "BANKSNP1"
+
+typedef struct SnapHeader {
+	char magic[8];
+	int p, r, stride, pad;
+	long long bytes;   //文件总长度
+	char reserved[32];  //文件头补齐到64字节
+} SnapHeader;
+
+typedef struct Scanner {  //在映射的文本中逐个读取数字
+	const char *s, *end;
+} Scanner;
+
+static size_t snap_sec(size_t n)  //一段n个int按64字节对齐后的字节数
+{
+	return (n * sizeof(int) + 63) / 64 * 64;
+}
+
+static void* map_file(const char* path, size_t* len, int writable)
+{
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+		if(fd >= 0) close(fd);
+		printf("无法读取文件%s\n", path);
+		return NULL;
+	}
+	void* m = mmap(NULL, st.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(m == MAP_FAILED) {
+		printf("无法映射文件%s\n", path);
+		return NULL;
+	}
+	*len = st.st_size;
+	return m;
+}
+
+static void scan_skip(Scanner* sc)  //跳过空白和注释
+{
+	while(sc->s < sc->end) {
+		if(*sc->s == '#')
+			while(sc->s < sc->end && *sc->s != '\n') sc->s++;
+		else if(*sc->s == ' ' || *sc->s == '\t' || *sc->s == '\r' || *sc->s == '\n') sc->s++;
+		else break;
+	}
+}
+
+static int scan_int(Scanner* sc, int* x)
+{
+	int neg = 0;
+	long long v = 0;
+	scan_skip(sc);
+	if(sc->s < sc->end && *sc->s == '-') {
+		neg = 1;
+		sc->s++;
+	}
+	if(sc->s >= sc->end || *sc->s < '0' || *sc->s > '9') return 0;
+	while(sc->s < sc->end && *sc->s >= '0' && *sc->s <= '9') {  //整段数字都读掉，溢出时不留半个数在后面
+		if(v <= 2147483648LL) v = v * 10 + (*sc->s - '0');
+		sc->s++;
+	}
+	if(v > 2147483647LL + neg) return 0;  //超出int范围按格式错误处理
+	*x = (int)(neg ? -v : v);
+	return 1;
+}
+
+static int scan_row(Scanner* sc, int* row, int r)
+{
+	for(int j = 0; j < r; j++)
+		if(!scan_int(sc, &row[j])) return 0;
+	return 1;
+}
+
+Banker* banker_load(const char* path)  //读取场景文件
+{
+	size_t len;
+	char* m = map_file(path, &len, 0);
+	if(m == NULL) return NULL;
+	Scanner sc = { m, m + len };
+	int p, r, ok;
+	Banker* b = NULL;
+	ok = scan_int(&sc, &p) && scan_int(&sc, &r) && p > 0 && r > 0;
+	if(ok) {
+		b = banker_new(p, r);
+		ok = scan_row(&sc, b->R, r) && scan_row(&sc, b->v, r);
+		for(int i = 0; ok && i < p; i++) ok = scan_row(&sc, ROW(b,c,i), r);
+		for(int i = 0; ok && i < p; i++) ok = scan_row(&sc, ROW(b,a,i), r);
+	}
+	munmap(m, len);
+	if(!ok) {
+		printf("场景文件%s格式错误或数值超出范围!\n", path);
+		if(b) banker_free(b);
+		return NULL;
+	}
+	for(int i = 0; i < p; i++)
+		update_need(b, i);
+	return b;
+}
+
+int snap_write(Banker* b, const char* path)  //把当前状态写成快照
+{
+	FILE* f = fopen(path, "wb");
+	if(f == NULL) {
+		printf("无法写入文件%s\n", path);
+		return -1;
+	}
+	size_t row = snap_sec(b->stride), mat = snap_sec((size_t)b->p * b->stride);
+	SnapHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SNAP_MAGIC, 8);
+	h.p = b->p;
+	h.r = b->r;
+	h.stride = b->stride;
+	h.bytes = sizeof(h) + 2 * row + 3 * mat;
+	//alloc_ints按64字节分配，补齐部分已清零，可以整段写出
+	int ok = fwrite(&h, sizeof(h), 1, f) == 1
+		&& fwrite(b->R, row, 1, f) == 1 && fwrite(b->v, row, 1, f) == 1
+		&& fwrite(b->c, mat, 1, f) == 1 && fwrite(b->a, mat, 1, f) == 1
+		&& fwrite(b->need, mat, 1, f) == 1;
+	if(fclose(f) != 0 || !ok) {
+		printf("写入快照%s失败!\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+Banker* banker_map(const char* path)  //映射快照，不做任何解析
+{
+	size_t len;
+	char* m = map_file(path, &len, 1);
+	if(m == NULL) return NULL;
+	SnapHeader* h = (SnapHeader*)m;
+	if(len < sizeof(SnapHeader) || memcmp(h->magic, SNAP_MAGIC, 8) != 0 || h->p <= 0 || h->r <= 0
+	   || h->stride != (h->r + ROW_ALIGN - 1) / ROW_ALIGN * ROW_ALIGN
+	   || (size_t)h->bytes != len
+	   || len != sizeof(SnapHeader) + 2 * snap_sec(h->stride) + 3 * snap_sec((size_t)h->p * h->stride)) {
+		printf("快照文件%s格式错误!\n", path);
+		munmap(m, len);
+		return NULL;
+	}
+	size_t row = snap_sec(h->stride), mat = snap_sec((size_t)h->p * h->stride);
+	Banker* b = banker_shell(h->p, h->r);
+	char* s = m + sizeof(SnapHeader);
+	b->R = (int*)s;
+	b->v = (int*)(s + row);
+	b->c = (int*)(s + 2 * row);
+	b->a = (int*)(s + 2 * row + mat);
+	b->need = (int*)(s + 2 * row + 2 * mat);
+	b->map = m;
+	b->maplen = len;
+	return b;
+}
+
+/*
+ * 回放请求日志：每条记录是 q 进程号 各资源数目（申请）或
+ * l 进程号 各资源数目（归还），#到行尾为注释。
+ * quiet时只输出汇总。
+ */
+int replay(Banker* b, const char* path, int quiet)
+{
+	size_t len;
+	char* m = map_file(path, &len, 0);
+	if(m == NULL) return -1;
+	Scanner sc = { m, m + len };
+	int* req = alloc_ints(b->stride);
+	long long cnt[6] = { 0 }, n = 0;  //各结果的次数，下标为BANK_*
+	const char* msg[] = { "成功", "超过已有资源", "超过所需最大值", "不安全", "数目为负", "进程号不存在" };
+	double t0 = now_sec();
+	while(1) {
+		scan_skip(&sc);
+		if(sc.s >= sc.end) break;
+		char op = *sc.s++;
+		int num, res = BANK_BAD_PID;
+		if((op != 'q' && op != 'l') || !scan_int(&sc, &num) || !scan_row(&sc, req, b->r)) {
+			printf("日志第%lld条记录格式错误或数值超出范围，停止回放\n", n + 1);
+			break;
+		}
+		n++;
+		if(num >= 0 && num < b->p)
+			res = op == 'q' ? bank_decide(b, num, req) : bank_release(b, num, req);
+		cnt[res]++;
+		if(!quiet)
+			printf("%lld %c 进程%d：%s\n", n, op, num, msg[res]);
+	}
+	double cost = now_sec() - t0;
+	printf("回放%lld条：", n);
+	for(int k = 0; k < 6; k++)
+		printf("%s%lld%s", msg[k], cnt[k], k < 5 ? "，" : "");
+	printf("\n耗时%.3fs（%.0f条/秒）\n", cost, cost > 0 ? n / cost : 0);
+	free(req);
+	munmap(m, len);
+	return 0;
+}
+
+/*
+ * 并发的资源管理服务：读写锁保护Banker状态。
+ * 安全检查要读全部进程和资源，按资源或进程分段加锁无法保证结果与串行相同，
+ * 所以只有一把锁：请求先在读锁下做只读检查，多个线程可以同时进行，
+ * 超过可用量、超过需求、数目为负的请求就在读锁下拒绝；
+ * 其余请求取写锁后由bank_decide在最新状态上重新检查并提交。
+ * 每个决定都对应取锁时的完整状态，结果与按取锁顺序串行调用bank_decide相同。
+ */
+typedef struct BankService {
+    Banker* b;
+    pthread_rwlock_t lock;
+} BankService;
+
+static __thread int* bs_tmp;  //每个线程自己的临时行
+
+void bs_init(BankService* s, Banker* b)
+{
+    s->b = b;
+    pthread_rwlock_init(&s->lock, NULL);
+}
+
+void bs_destroy(BankService* s)
+{
+    pthread_rwlock_destroy(&s->lock);
+}
+
+void bs_thread_done()  //线程退出前释放临时行
+{
+    free(bs_tmp);
+    bs_tmp = NULL;
+}
+
+int bs_request(BankService* s, int num, const int* req)
+{
+    Banker* b = s->b;
+    if(num < 0 || num >= b->p) return BANK_BAD_PID;
+    if(bs_tmp == NULL) bs_tmp = alloc_ints(b->stride);
+    pthread_rwlock_rdlock(&s->lock);
+    int v = bank_check(b, num, req, bs_tmp);
+    pthread_rwlock_unlock(&s->lock);
+    if(v == BANK_OVER_AVAIL || v == BANK_OVER_NEED || v == BANK_INVALID) return v;
+    pthread_rwlock_wrlock(&s->lock);
+    v = bank_decide(b, num, req);  //读锁释放后状态可能已变，重新检查
+    pthread_rwlock_unlock(&s->lock);
+    return v;
+}
+
+int bs_release(BankService* s, int num, const int* rel)
+{
+    if(num < 0 || num >= s->b->p) return BANK_BAD_PID;
+    pthread_rwlock_wrlock(&s->lock);
+    int v = bank_release(s->b, num, rel);
+    pthread_rwlock_unlock(&s->lock);
+    return v;
+}
+
+typedef struct BenchWorker {
+    BankService* s;
+    int ops, seed;
+    long long ok;
+} BenchWorker;
+
+static void* bench_mt_worker(void* arg)
+{
+    BenchWorker* w = arg;
+    Banker* b = w->s->b;
+    unsigned seed = w->seed;
+    int* req = alloc_ints(b->stride);
+    for(int k = 0; k < w->ops; k++) {
+        int num = rand_r(&seed) % b->p;
+        int j = rand_r(&seed) % b->r;
+        memset(req, 0, b->stride * sizeof(int));
+        req[j] = 1;
+        if(rand_r(&seed) % 3 == 0) {  //三分之一是归还
+            if(bs_release(w->s, num, req) == BANK_OK) w->ok++;
+        }
+        else if(bs_request(w->s, num, req) == BANK_OK) w->ok++;
+    }
+    free(req);
+    bs_thread_done();
+    return NULL;
+}
+
+void bench_mt(int maxThreads)  //./banker mt [线程数]
+{
+    const int P = 2000, RES = 32, OPS = 200000;
+    double base = 0;
+    printf("线程数\t总操作数\t成功\t吞吐(ops/s)\t加速比\n");
+    for(int t = 1; t <= maxThreads; t++) {
+        Banker* b = banker_new(P, RES);
+        srand(1);
+        for(int j = 0; j < RES; j++) b->R[j] = b->v[j] = 2 * P;  //约为最大需求总量的80%
+        for(int i = 0; i < P; i++) {
+            for(int j = 0; j < RES; j++) ROW(b,c,i)[j] = 1 + rand() % 4;
+            update_need(b, i);
+        }
+        BankService s;
+        bs_init(&s, b);
+        pthread_t* tid = malloc(t * sizeof(pthread_t));
+        BenchWorker* w = malloc(t * sizeof(BenchWorker));
+        double t0 = now_sec();
+        for(int k = 0; k < t; k++) {
+            w[k].s = &s;
+            w[k].ops = OPS;
+            w[k].seed = 7 + k;
+            w[k].ok = 0;
+            pthread_create(&tid[k], NULL, bench_mt_worker, &w[k]);
+        }
+        long long ok = 0;
+        for(int k = 0; k < t; k++) {
+            pthread_join(tid[k], NULL);
+            ok += w[k].ok;
+        }
+        double ops = (double)OPS * t / (now_sec() - t0);
+        if(t == 1) base = ops;
+        printf("%d\t%d\t\t%lld\t%.0f\t%.2f\n", t, OPS * t, ok, ops, ops / base);
+        bs_destroy(&s);
+        banker_free(b);
+        free(tid);
+        free(w);
+    }
+}
+
+static int path_valid(Banker* b)  //检查path是否是一个安全序列
+{
+    int* curV = alloc_ints(b->stride);
+    int ok = 1;
+    memcpy(curV, b->v, b->stride * sizeof(int));
+    for(int k = 0; k < b->p && ok; k++) {
+        ok = vec_le(ROW(b,need,b->path[k]), curV, b->stride);
+        vec_add(curV, ROW(b,a,b->path[k]), b->stride);
+    }
+    free(curV);
+    return ok;
+}
+
+void bench_par(int maxThreads)  //./banker par [线程数]
+{
+    const int P = 50000, RES = 16, REPS = 5, ROUNDS = 64;
+    Banker* b = banker_new(P, RES);
+    int* prev = alloc_ints(b->stride);
+    int* cur = alloc_ints(b->stride);
+    srand(1);
+    /*
+     * 按轮构造状态：第g组进程的仍需量在某个资源上超过前g-1组归还之前的
+     * 可用量，所以并行算法恰好需要ROUNDS轮，进程号随机打乱。
+     */
+    for(int j = 0; j < RES; j++) b->R[j] = b->v[j] = prev[j] = cur[j] = 4;
+    for(int k = 0; k < P; k++) b->path[k] = k;
+    for(int k = P - 1; k > 0; k--) {
+        int u = rand() % (k + 1), t = b->path[k];
+        b->path[k] = b->path[u];
+        b->path[u] = t;
+    }
+    for(int g = 0, k = 0; g < ROUNDS; g++) {
+        int end = (int)((long long)P * (g + 1) / ROUNDS);
+        int* next = alloc_ints(b->stride);
+        memcpy(next, cur, b->stride * sizeof(int));
+        for(; k < end; k++) {
+            int i = b->path[k], hard = rand() % RES;
+            for(int j = 0; j < RES; j++) {
+                int* a = ROW(b,a,i);
+                int lim = g > 0 && j == hard ? cur[j] : prev[j];
+                int need = g > 0 && j == hard ? prev[j] + 1 + rand() % (cur[j] - prev[j]) : rand() % (lim + 1);
+                a[j] = rand() % 4;
+                ROW(b,c,i)[j] = need + a[j];
+                b->R[j] += a[j];
+                next[j] += a[j];
+            }
+            update_need(b, i);
+        }
+        memcpy(prev, cur, b->stride * sizeof(int));
+        memcpy(cur, next, b->stride * sizeof(int));
+        free(next);
+    }
+    free(prev);
+    free(cur);
+    double t0 = now_sec();
+    int ref = 0;
+    for(int k = 0; k < REPS; k++) ref = safe_worklist(b);
+    double serial = (now_sec() - t0) / REPS;
+    printf("进程数%d 资源数%d 工作表算法: %s %.2fms\n", P, RES, ref ? "安全" : "不安全", serial * 1e3);
+    printf("线程数\t轮数\t耗时(ms)\t加速比\t结果\n");
+    double base = 0;
+    for(int t = 1; t <= maxThreads; t++) {
+        int res = 0, rounds = 0;
+        t0 = now_sec();
+        for(int k = 0; k < REPS; k++) res = safe_parallel(b, t, &rounds);
+        double cost = (now_sec() - t0) / REPS;
+        if(t == 1) base = cost;
+        printf("%d\t%d\t%.2f\t\t%.2f\t%s\n", t, rounds, cost * 1e3, base / cost,
+               res != ref ? "与串行不一致!" : !res ? "不安全" : path_valid(b) ? "安全，序列有效" : "序列无效!");
+    }
+    banker_free(b);
+}
+
+void enum_report(Banker* b, int samples)  //统计安全序列并抽样输出
+{
+    SeqEnum e;
+    seq_enum_init(&e, b, (size_t)256 << 20);
+    double t0 = now_sec();
+    double n = seq_enum_count(&e);
+    double cost = now_sec() - t0;
+    if(e.overflow) {
+        printf("记忆化表超过内存上限%zuMB（已记录%zu个状态），放弃枚举\n", e.limit >> 20, e.n);
+        seq_enum_free(&e);
+        return;
+    }
+    if(n == 0) {
+        printf("当前状态不安全，没有安全序列\n");
+        seq_enum_free(&e);
+        return;
+    }
+    printf(n < 9007199254740992.0 ? "安全序列共%.0f个" : "安全序列约%.6g个", n);
+    printf("（记忆化%zu个状态，占用%.1fMB，耗时%.3fs，全排列为%.6g个）\n",
+           e.n, seq_bytes(&e, e.cap) / 1048576.0, cost, e.fact[b->p]);
+    int* seq = malloc(b->p * sizeof(int));
+    unsigned seed = 1;
+    for(int k = 0; k < samples; k++) {
+        seq_enum_sample(&e, seq, &seed);
+        printf("抽样%d：", k + 1);
+        for(int i = 0; i < b->p; i++) printf("%2d", seq[i]);
+        printf("\n");
+    }
+    int worst = 0;
+    printf("每个进程最早能排的位置：");
+    for(int i = 0; i < b->p; i++) {
+        printf("%2d", e.earliest[i] + 1);
+        if(e.earliest[i] > e.earliest[worst]) worst = i;
+    }
+    printf("\n最受约束的进程：%d（最早排在第%d位）\n", worst, e.earliest[worst] + 1);
+    free(seq);
+    seq_enum_free(&e);
+}
+
+/*
+ * 随机负载：由种子确定的合法状态和请求流，用来比较各种安全检查。
+ * util为已分配量占最大需求的比例；cont为争用度，0时所有进程一开始
+ * 就能满足，1时可用量只够按某个随机顺序依次完成。
+ */
+typedef struct GenParam {
+    int p, r, ops, threads;
+    double util, cont;
+    unsigned long long seed;
+} GenParam;
+
+typedef struct GenOp {
+    char op;    //'q'申请，'l'归还
+    int num;
+    int* row;   //按stride补齐
+} GenOp;
+
+static unsigned long long gen_next(unsigned long long* s)  //xorshift64*
+{
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * 0x2545f4914f6cdd1dULL;
+}
+
+static int gen_int(unsigned long long* s, int n)  //[0, n)
+{
+    return (int)(gen_next(s) >> 33) % n;
+}
+
+static double gen_real(unsigned long long* s)  //[0, 1)
+{
+    return (gen_next(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+Banker* banker_clone(Banker* b)
+{
+    Banker* x = banker_new(b->p, b->r);
+    size_t row = b->stride * sizeof(int), mat = (size_t)b->p * row;
+    memcpy(x->R, b->R, row);
+    memcpy(x->v, b->v, row);
+    memcpy(x->c, b->c, mat);
+    memcpy(x->a, b->a, mat);
+    memcpy(x->need, b->need, mat);
+    return x;
+}
+
+Banker* gen_state(const GenParam* g)
+{
+    unsigned long long s = g->seed * 2 + 1;
+    int p = g->p, r = g->r;
+    Banker* b = banker_new(p, r);
+    int* order = malloc(p * sizeof(int));
+    int* sum = alloc_ints(b->stride);   //按order累计的已分配量
+    int* maxn = alloc_ints(b->stride);  //每个资源的最大仍需量
+    for(int i = 0; i < p; i++) {
+        int *c = ROW(b,c,i), *a = ROW(b,a,i), left = 0;
+        for(int j = 0; j < r; j++) {
+            c[j] = 1 + gen_int(&s, 10);
+            a[j] = 0;
+            for(int u = 0; u < c[j]; u++)
+                a[j] += gen_real(&s) < g->util;
+            left += c[j] - a[j];
+        }
+        if(left == 0) a[gen_int(&s, r)]--;  //保证每个进程都还有仍需量
+        update_need(b, i);
+        order[i] = i;
+    }
+    for(int k = p - 1; k > 0; k--) {
+        int u = gen_int(&s, k + 1), t = order[k];
+        order[k] = order[u];
+        order[u] = t;
+    }
+    //v至少要让order成为安全序列，再按争用度向“所有进程都能满足”放宽
+    for(int k = 0; k < p; k++) {
+        int i = order[k];
+        for(int j = 0; j < r; j++) {
+            int n = ROW(b,need,i)[j];
+            if(n - sum[j] > b->v[j]) b->v[j] = n - sum[j];
+            if(n > maxn[j]) maxn[j] = n;
+            sum[j] += ROW(b,a,i)[j];
+        }
+    }
+    for(int j = 0; j < r; j++) {
+        if(maxn[j] > b->v[j]) b->v[j] += (int)((1 - g->cont) * (maxn[j] - b->v[j]) + 0.5);
+        b->R[j] = b->v[j] + sum[j];
+    }
+    free(order);
+    free(sum);
+    free(maxn);
+    return b;
+}
+
+/*
+ * 在b的副本上用bank_decide模拟，生成ops条请求：申请不超过仍需量，
+ * 归还不超过已分配量，所以各条都有意义。
+ */
+GenOp* gen_stream(const GenParam* g, Banker* b)
+{
+    unsigned long long s = g->seed * 2 + 3;
+    Banker* x = banker_clone(b);
+    GenOp* ops = malloc(g->ops * sizeof(GenOp));
+    int* rows = alloc_ints((size_t)g->ops * b->stride);
+    for(int k = 0; k < g->ops; k++) {
+        GenOp* o = &ops[k];
+        int num = gen_int(&s, b->p), *a = ROW(x,a,num), *need = ROW(x,need,num), j, n = 0;
+        o->num = num;
+        o->row = rows + (size_t)k * b->stride;
+        for(j = 0; j < b->r && a[j] == 0; j++);
+        if(j < b->r && gen_int(&s, 10) < 3) {
+            o->op = 'l';
+            for(j = 0; j < b->r; j++)
+                if(a[j] > 0 && gen_int(&s, 2)) n += o->row[j] = 1 + gen_int(&s, a[j]);
+            if(n == 0) {
+                for(j = 0; a[j] == 0; j++);
+                o->row[j] = a[j];
+            }
+            bank_release(x, num, o->row);
+            continue;
+        }
+        o->op = 'q';
+        for(int t = 0; t < 2; t++) {  //在一两个资源上申请
+            j = gen_int(&s, b->r);
+            if(need[j] > 0 && o->row[j] == 0) o->row[j] = 1 + gen_int(&s, need[j] < 3 ? need[j] : 3);
+        }
+        bank_decide(x, num, o->row);
+    }
+    banker_free(x);
+    return ops;
+}
+
+void gen_free(GenOp* ops)
+{
+    free(ops[0].row);
+    free(ops);
+}
+
+int gen_write(Banker* b, const GenOp* ops, int n, const char* scen, const char* log)
+{
+    FILE* f;
+    if(scen) {
+        if((f = fopen(scen, "w")) == NULL) {
+            printf("无法写入文件%s\n", scen);
+            return -1;
+        }
+        fprintf(f, "# 进程数 资源数\n%d %d\n# R[]\n", b->p, b->r);
+        for(int j = 0; j < b->r; j++) fprintf(f, "%d%c", b->R[j], j + 1 < b->r ? ' ' : '\n');
+        fprintf(f, "# v[]\n");
+        for(int j = 0; j < b->r; j++) fprintf(f, "%d%c", b->v[j], j + 1 < b->r ? ' ' : '\n');
+        fprintf(f, "# c[][]\n");
+        for(int i = 0; i < b->p; i++)
+            for(int j = 0; j < b->r; j++) fprintf(f, "%d%c", ROW(b,c,i)[j], j + 1 < b->r ? ' ' : '\n');
+        fprintf(f, "# a[][]\n");
+        for(int i = 0; i < b->p; i++)
+            for(int j = 0; j < b->r; j++) fprintf(f, "%d%c", ROW(b,a,i)[j], j + 1 < b->r ? ' ' : '\n');
+        fclose(f);
+    }
+    if(log) {
+        if((f = fopen(log, "w")) == NULL) {
+            printf("无法写入文件%s\n", log);
+            return -1;
+        }
+        for(int k = 0; k < n; k++) {
+            fprintf(f, "%c %d", ops[k].op, ops[k].num);
+            for(int j = 0; j < b->r; j++) fprintf(f, " %d", ops[k].row[j]);
+            fprintf(f, "\n");
+        }
+        fclose(f);
+    }
+    return 0;
+}
+
+/*
+ * 不用缓存、每次都做完整安全检查的分配，结果与bank_decide相同，
+ * check为所用的安全检查算法。
+ */
+int decide_full(Banker* b, int num, const int* req, int (*check)(Banker*))
+{
+    int *a = ROW(b,a,num), *need = ROW(b,need,num);
+    if(!vec_le(req, b->v, b->stride)) return BANK_OVER_AVAIL;
+    if(!vec_le(req, need, b->stride)) return BANK_OVER_NEED;
+    vec_add(a, req, b->stride);
+    vec_sub(need, req, b->stride);
+    vec_sub(b->v, req, b->stride);
+    if(!check(b)) {
+        vec_sub(a, req, b->stride);
+        vec_add(need, req, b->stride);
+        vec_add(b->v, req, b->stride);
+        return BANK_UNSAFE;
+    }
+    int j;
+    for(j = 0; j < b->r && need[j] == 0; j++);
+    if(j == b->r) {  //已满足最大需求，释放资源
+        vec_add(b->v, a, b->stride);
+        memset(a, 0, b->stride * sizeof(int));
+        update_need(b, num);
+    }
+    return BANK_OK;
+}
+
+static int bench_threads;
+
+static int safe_parallel_bench(Banker* b)
+{
+    return safe_parallel(b, bench_threads, NULL);
+}
+
+static int cmp_double(const void* x, const void* y)
+{
+    double u = *(const double*)x, w = *(const double*)y;
+    return (u > w) - (u < w);
+}
+
+void bench_decide(const GenParam* g)  //./banker bench，各安全检查的吞吐与延迟
+{
+    struct {
+        const char* name;
+        int (*check)(Banker*);  //NULL表示bank_decide
+    } var[] = {
+        { "增量检查", NULL },
+        { "safe_scan", safe_scan },
+        { "safe_worklist", safe_worklist },
+        { "safe_parallel", safe_parallel_bench },
+    };
+    int nv = sizeof(var) / sizeof(var[0]);
+    Banker* b0 = gen_state(g);
+    GenOp* ops = gen_stream(g, b0);
+    int* ref = malloc(g->ops * sizeof(int));
+    double* lat = malloc(g->ops * sizeof(double));
+    bench_threads = g->threads;
+    printf("进程数%d 资源数%d 利用率%.2f 争用度%.2f 操作数%d 种子%llu 并行线程数%d\n",
+           g->p, g->r, g->util, g->cont, g->ops, g->seed, g->threads);
+    printf("算法\t\t决定/秒\t\tp50(us)\tp90(us)\tp99(us)\t最大(us)\t接纳率\n");
+    for(int k = 0; k < nv; k++) {
+        if(var[k].check == safe_scan && g->p > 4000) {
+            printf("%s\t跳过（进程数太多）\n", var[k].name);
+            continue;
+        }
+        Banker* b = banker_clone(b0);
+        int n = 0, ok = 0, diff = 0;
+        double total = 0;
+        for(int t = 0; t < g->ops; t++) {
+            if(ops[t].op == 'l') {
+                bank_release(b, ops[t].num, ops[t].row);
+                continue;
+            }
+            double t0 = now_sec();
+            int res = var[k].check ? decide_full(b, ops[t].num, ops[t].row, var[k].check)
+                                   : bank_decide(b, ops[t].num, ops[t].row);
+            lat[n] = now_sec() - t0;
+            total += lat[n];
+            if(k == 0) ref[n] = res;
+            else diff += res != ref[n];
+            ok += res == BANK_OK;
+            n++;
+        }
+        qsort(lat, n, sizeof(double), cmp_double);
+        printf("%s\t%.0f\t\t%.2f\t%.2f\t%.2f\t%.2f\t\t%.1f%%", var[k].name, n / total,
+               lat[n / 2] * 1e6, lat[n * 9 / 10] * 1e6, lat[n * 99 / 100] * 1e6, lat[n - 1] * 1e6, 100.0 * ok / n);
+        if(diff) printf("\t%d个结果与增量检查不同!", diff);
+        printf("\n");
+        banker_free(b);
+    }
+    free(ref);
+    free(lat);
+    gen_free(ops);
+    banker_free(b0);
+}
+
+/*
+ * ./banker gen|bench [-p 进程数] [-r 资源数] [-u 利用率] [-k 争用度]
+ *                    [-n 操作数] [-S 种子] [-t 线程数] [-o 场景文件] [-L 请求日志]
+ * gen把生成的状态和请求流写成-f、-l能读的文件，bench比较各安全检查。
+ */
+int gen_main(int argc, char* argv[])
+{
+    GenParam g = { 1000, 16, 10000, 4, 0.5, 0.8, 1 };
+    const char *scen = NULL, *log = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "p:r:u:k:n:S:t:o:L:")) != -1) {
+        switch(opt) {
+        case 'p': g.p = atoi(optarg); break;
+        case 'r': g.r = atoi(optarg); break;
+        case 'u': g.util = atof(optarg); break;
+        case 'k': g.cont = atof(optarg); break;
+        case 'n': g.ops = atoi(optarg); break;
+        case 'S': g.seed = strtoull(optarg, NULL, 10); break;
+        case 't': g.threads = atoi(optarg); break;
+        case 'o': scen = optarg; break;
+        case 'L': log = optarg; break;
+        default: return 1;
+        }
+    }
+    if(g.p <= 0 || g.r <= 0 || g.ops <= 0 || g.threads <= 0 || g.util < 0 || g.util > 1 || g.cont < 0 || g.cont > 1) {
+        printf("参数不合法!\n");
+        return 1;
+    }
+    if(strcmp(argv[0], "bench") == 0) {
+        bench_decide(&g);
+        return 0;
+    }
+    Banker* b = gen_state(&g);
+    GenOp* ops = gen_stream(&g, b);
+    int ret = gen_write(b, ops, g.ops, scen, log) == 0 ? 0 : 1;
+    gen_free(ops);
+    banker_free(b);
+    return ret;
+}
@@ -1,7 +1,15 @@
+/*
+ * 进程调度模拟
+ * 编译：gcc dispach.c -o dispach -lm    （作业生成器用到log、pow，需要链接数学库）
+ */
 #include<stdio.h>
 #include<malloc.h>
 #include<string.h>
 #include<stdlib.h>
+#include<time.h>
+#include<math.h>
+#include<stdarg.h>
+#include<unistd.h>
 
 typedef struct PCB{
     char name[20];
@@ -16,6 +24,14 @@ typedef struct PCB{
     int copyRunning_time;  //用于时间片轮转
 //  进程开始运行的时间
     int start_time;
+//  第一次被调度的时间，用于计算响应时间
+    int first_time;
+//  多级反馈队列中所在的级别
+    int level;
+//  完全公平调度的虚拟运行时间，以1/1024个时间单位计
+    long long vruntime;
+//  多核调度中上一次运行所在的核，-1表示还没运行过
+    int core;
 
     struct PCB* next;
 } PCB;
@@ -31,32 +47,26 @@ void Queueinit(PCBQueue* queue){
         return;
     }
     queue->size = 0;
-    queue->LastProg = (PCB*)malloc(sizeof(PCB));
-    queue->firstProg = queue->LastProg;
+    queue->firstProg = NULL;
+    queue->LastProg = NULL;
 }
 
-
-
-void EnterQueue(PCBQueue* queue,PCB* pro){   //加入进程队列
-    queue->LastProg->next = (PCB*)malloc(sizeof(PCB));
-    queue->LastProg = queue->LastProg->next;
-    queue->LastProg->enter_time = pro->enter_time;
-//    将name复制给 LastProg
-    memcpy(queue->LastProg->name,pro->name,sizeof(pro->name));
-    queue->LastProg->priority = pro->priority;
-    queue->LastProg->running_time = pro->running_time;
-    queue->LastProg->copyRunning_time = pro->copyRunning_time;
-    queue->LastProg->start_time = pro->start_time;
+//加入进程队列：直接用PCB自带的next链接，不分配也不复制，一个PCB同一时间只能在一个队列里
+void EnterQueue(PCBQueue* queue,PCB* pro){
+    pro->next = NULL;
+    if(queue->LastProg == NULL)
+        queue->firstProg = pro;
+    else
+        queue->LastProg->next = pro;
+    queue->LastProg = pro;
     queue->size++;
 }
 PCB* poll(PCBQueue* queue){
-    PCB* temp = queue->firstProg->next;
-    if(temp == queue->LastProg){
-        queue->LastProg=queue->firstProg;
-        queue->size--;
-        return temp;
-    }
-    queue->firstProg->next = queue->firstProg->next->next;
+    PCB* temp = queue->firstProg;
+    queue->firstProg = temp->next;
+    if(queue->firstProg == NULL)
+        queue->LastProg = NULL;
+    temp->next = NULL;
     queue->size--;
     return temp;
 }
@@ -74,300 +84,986 @@ void inputPCB(PCB pro[],int num){
     }
 }
 
-//冒泡排序算法（每次找到最大的放在末尾）
+/*
+ * 算法参数：交互时提示后从标准输入读；命令行用-x给出时按提示的顺序从paramText读，
+ * 不再提示，缺少的参数按0处理。quietMode为真时不输出表头和逐个进程的结果。
+ */
+static const char* paramText = NULL;
+static int quietMode = 0;
+void ask(const char* fmt,...){
+    if(paramText != NULL)
+        return;
+    va_list ap;
+    va_start(ap,fmt);
+    vprintf(fmt,ap);
+    va_end(ap);
+}
+int readInt(int* v){
+    *v = 0;
+    if(paramText == NULL)
+        return scanf("%d",v) == 1;
+    int used;
+    if(sscanf(paramText,"%d%n",v,&used) != 1)
+        return 0;
+    paramText += used;
+    return 1;
+}
+
+//按下标数组重排pro[start,start+len)，每个PCB只移动一次
+void permuteByIndex(PCB pro[],int start,int len,const int idx[]){
+    PCB* buf = (PCB*)malloc(len*sizeof(PCB));
+    for(int k=0;k<len;k++)
+        buf[k] = pro[start+idx[k]];
+    memcpy(pro+start,buf,len*sizeof(PCB));
+    free(buf);
+}
+
+//按到达时间做基数排序（稳定，O(n)），排序的是(到达时间,下标)对，最后再重排PCB
 void sortWithEnterTime(PCB pro[],int num){
-    for(int i=1;i<num;i++){
-        for(int j= 0;j<num-i;j++){
-            if(pro[j].enter_time>pro[j+1].enter_time){
-                PCB temp = pro[j];
-                pro[j] = pro[j+1];
-                pro[j+1] = temp;
-            }
+    if(num <= 1)
+        return;
+    unsigned int* key = (unsigned int*)malloc(num*sizeof(unsigned int));
+    unsigned int* key2 = (unsigned int*)malloc(num*sizeof(unsigned int));
+    int* idx = (int*)malloc(num*sizeof(int));
+    int* idx2 = (int*)malloc(num*sizeof(int));
+    for(int i=0;i<num;i++){
+        key[i] = (unsigned int)pro[i].enter_time ^ 0x80000000u;   //翻转符号位，负数也按大小排
+        idx[i] = i;
+    }
+    for(int shift=0;shift<32;shift+=8){    //每趟按8位分配，共4趟
+        int count[257] = {0};
+        for(int i=0;i<num;i++)
+            count[((key[i]>>shift)&255)+1]++;
+        if(count[((key[0]>>shift)&255)+1] == num)    //这8位全都相同，跳过这一趟
+            continue;
+        for(int b=0;b<256;b++)
+            count[b+1] += count[b];
+        for(int i=0;i<num;i++){
+            int pos = count[(key[i]>>shift)&255]++;
+            key2[pos] = key[i];
+            idx2[pos] = idx[i];
         }
+        unsigned int* tk = key; key = key2; key2 = tk;
+        int* ti = idx; idx = idx2; idx2 = ti;
     }
+    permuteByIndex(pro,0,num,idx);
+    free(key);
+    free(key2);
+    free(idx);
+    free(idx2);
 }
 
-void FCFS(PCB pro[],int num){
-    printf("进程 到达时间  服务时间 开始时间 完成时间 周转时间 带权周转时间\n");
-    sortWithEnterTime(pro,num);    //按照进入顺序排序
-    PCBQueue* queue = (PCBQueue*)malloc(sizeof(PCBQueue));
-    Queueinit(queue);
-    EnterQueue(queue,&pro[0]);
-    int time = pro[0].enter_time;
-    int pronum=1;    //记录当前的进程
-    //平均周转时间
-    float sum_T_time = 0;
-//    带权平均周转时间
-    float sum_QT_time = 0 ;
-
-    while(queue->size>0){
-        PCB* curpro = poll(queue);   //从进程队列中取出进程
-        if(time < curpro->enter_time)
-            time =  curpro->enter_time;
-        //完成时间
-        int done_time = time+curpro->running_time;
-        //周转时间（作业完成的时间-作业到达的时间）
-        int T_time = done_time - curpro->enter_time;
-        sum_T_time += T_time;
-        // 带权周转时间（（作业完成的时间-作业到达的时间）/ 作业运行时间）
-        float QT_time = T_time / (curpro->running_time+0.0) ;
-        sum_QT_time += QT_time;
-        for(int tt = time;tt<=done_time && pronum<num;tt++){    //模拟进程的执行过程
-            if(tt >= pro[pronum].enter_time){
-                EnterQueue(queue,&pro[pronum]);
-                pronum++;
-            }
-        }
-        printf("%s\t%d\t%d\t%d\t%d\t%d\t%.2f\n",curpro->name,curpro->enter_time,curpro->running_time,time,done_time
-               ,T_time,QT_time);
-        time += curpro->running_time;
-        if(queue->size==0 && pronum < num){   //防止出现前一个进程执行完到下一个进程到达之间无进程进入
-            EnterQueue(queue,&pro[pronum]);
-            pronum++;
-        }
+//就绪队列：按调度策略排序的二叉堆，存放指向pro[]的指针，出队O(log n)
+typedef struct PCBHeap{
+    PCB** data;
+    int size;
+    int (*before)(const PCB*,const PCB*);   //before(x,y)为真时x先运行
+} PCBHeap;
+
+void heapInit(PCBHeap* heap,int cap,int (*before)(const PCB*,const PCB*)){
+    heap->data = (PCB**)malloc((cap > 0 ? cap : 1)*sizeof(PCB*));
+    heap->size = 0;
+    heap->before = before;
+}
+
+//策略上不分先后时，pro[]中靠前（先到达）的先运行
+int heapBefore(PCBHeap* heap,PCB* x,PCB* y){
+    if(heap->before(x,y)) return 1;
+    if(heap->before(y,x)) return 0;
+    return x < y;
+}
+
+void siftDown(PCBHeap* heap,int k){
+    PCB* x = heap->data[k];
+    while(2*k+1 < heap->size){
+        int c = 2*k+1;
+        if(c+1 < heap->size && heapBefore(heap,heap->data[c+1],heap->data[c]))
+            c++;
+        if(!heapBefore(heap,heap->data[c],x))
+            break;
+        heap->data[k] = heap->data[c];
+        k = c;
     }
-    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\n",sum_T_time/(num+0.0),sum_QT_time/(num+0.0));
+    heap->data[k] = x;
 }
 
-//按照运行时间排序
-void sortWithLongth(PCB pro[],int start,int end){
-    int len = end - start;
-    if(len == 1)
-        return;
-    for(int i=1;i<len;i++){
-        for(int j= start;j<end-i;j++){
-            if(pro[j].running_time>pro[j+1].running_time){
-                PCB temp = pro[j];
-                pro[j] = pro[j+1];
-                pro[j+1] = temp;
-            }
-        }
+void heapPush(PCBHeap* heap,PCB* pro){
+    int k = heap->size++;
+    while(k > 0 && heapBefore(heap,pro,heap->data[(k-1)/2])){
+        heap->data[k] = heap->data[(k-1)/2];
+        k = (k-1)/2;
     }
+    heap->data[k] = pro;
 }
-void SJF(PCB pro[],int num) {
-    printf("进程 到达时间  服务时间 开始时间 完成时间 周转时间 带权周转时间\n");
-    sortWithEnterTime(pro,num);
-    PCBQueue* queue = (PCBQueue*)malloc(sizeof(PCBQueue));;
-    Queueinit(queue);
-    EnterQueue(queue,&pro[0]);
-    int time = pro[0].enter_time;
-    int pronum=1;    //记录当前的进程
-    float sum_T_time = 0,sum_QT_time = 0;
-    while(queue->size>0){
-        PCB* curpro = poll(queue);   //从进程队列中取出进程
-        if(time <  curpro->enter_time)
-            time =  curpro->enter_time;
-        int done_time = time+curpro->running_time;
-        int T_time = done_time - curpro->enter_time;
-        float QT_time = T_time / (curpro->running_time+0.0) ;
-        sum_T_time += T_time;
-        sum_QT_time += QT_time;
-        int pre = pronum;
-        for(int tt = time;tt<=done_time&&pronum<num;tt++){    //模拟进程的执行过程
-            if(tt>=pro[pronum].enter_time){ // 统计从此任务开始到结束之间有几个进程到达
-                pronum++;
-            }
-        }
-        sortWithLongth(pro,pre,pronum);//将到达的进程按照服务时间排序
-        for(int i=pre;i<pronum;i++){    //将进程链入队列
-            EnterQueue(queue,&pro[i]);
-        }
-        pre = pronum;
-        printf("%s\t%d\t%d\t%d\t%d\t%d\t%.2f\n",curpro->name,curpro->enter_time,curpro->running_time,time,done_time
-               ,T_time,QT_time);
-        time +=  curpro->running_time;
-        if(queue->size==0&&pronum<num){   //防止出现前一个进程执行完到下一个进程到达之间无进程进入
-            EnterQueue(queue,&pro[pronum]);
-            pronum++;
-        }
+
+PCB* heapPop(PCBHeap* heap){
+    PCB* top = heap->data[0];
+    heap->data[0] = heap->data[--heap->size];
+    if(heap->size > 0)
+        siftDown(heap,0);
+    return top;
+}
+
+/*
+ * 离散事件模拟：事件按时间排序，同一时刻先处理到达，再按产生顺序处理
+ * 完成和时间片到期；同一时刻的事件全部处理完之后才调度下一个进程。
+ * 到达事件按到达时间顺序逐个产生，模拟代价只与事件数有关，与时间跨度无关。
+ */
+#define EV_ARRIVAL 0
+#define EV_COMPLETION 1
+#define EV_EXPIRY 2
+#define EV_BOOST 3    //多级反馈队列的周期性优先级提升
+#define EV_BALANCE 4  //多核调度的周期性负载均衡
+
+typedef struct Event{
+    int time;
+    int type;
+    long seq;    //产生顺序
+    int gen;     //完成和到期事件产生时的调度代数，与当前不同说明已被抢占作废
+    PCB* pro;
+} Event;
+
+typedef struct EventQueue{    //事件的小根堆
+    Event* data;
+    int size;
+    int cap;
+    long seq;
+} EventQueue;
+
+int eventBefore(const Event* x,const Event* y){
+    if(x->time != y->time) return x->time < y->time;
+    if((x->type != EV_ARRIVAL) != (y->type != EV_ARRIVAL)) return x->type == EV_ARRIVAL;
+    return x->seq < y->seq;
+}
+
+void eventPush(EventQueue* events,int time,int type,int gen,PCB* pro){
+    if(events->size == events->cap){
+        events->cap = events->cap ? 2*events->cap : 4;
+        events->data = (Event*)realloc(events->data,events->cap*sizeof(Event));
     }
-    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\n",sum_T_time/(num+0.0),sum_QT_time/num);
+    Event ev = {time,type,events->seq++,gen,pro};
+    int k = events->size++;
+    while(k > 0 && eventBefore(&ev,&events->data[(k-1)/2])){
+        events->data[k] = events->data[(k-1)/2];
+        k = (k-1)/2;
+    }
+    events->data[k] = ev;
 }
-//按照响应比排序（倒序）
-void sortWithResponse(PCB pro[],int start,int end){
-    int len = end - start;
-    if(len == 1)
-        return;
-    for(int i=1;i<len;i++){
-        for(int j= start;j<end-i;j++){
-            //计算响应比
-            float m = (pro[j].start_time-pro[j].enter_time+pro[j].running_time)/(pro[j].running_time+0.0);
-            float n = (pro[j+1].start_time-pro[j+1].enter_time+pro[j+1].running_time)/(pro[j+1].running_time+0.0);
-            if(m < n){
-                PCB temp = pro[j];
-                pro[j] = pro[j+1];
-                pro[j+1] = temp;
-            }
-        }
+
+Event eventPop(EventQueue* events){
+    Event top = events->data[0];
+    Event x = events->data[--events->size];
+    int k = 0;
+    while(2*k+1 < events->size){
+        int c = 2*k+1;
+        if(c+1 < events->size && eventBefore(&events->data[c+1],&events->data[c]))
+            c++;
+        if(!eventBefore(&events->data[c],&x))
+            break;
+        events->data[k] = events->data[c];
+        k = c;
     }
+    if(events->size > 0)
+        events->data[k] = x;
+    return top;
 }
-//高响应比优先
-void HRRN(PCB pro[],int num) {
-    printf("进程 到达时间  服务时间 开始时间 完成时间 周转时间 带权周转时间\n");
-    sortWithEnterTime(pro,num);
-    PCBQueue* queue = (PCBQueue*)malloc(sizeof(PCBQueue));;
-    Queueinit(queue);
-    EnterQueue(queue,&pro[0]);
-    int time = pro[0].enter_time;
-    int pronum=1;    //记录当前的进程
-    float sum_T_time = 0,sum_QT_time = 0;
-    while(queue->size>0){
-        PCB* curpro = poll(queue);   //从进程队列中取出进程
-        if(time <  curpro->enter_time)
-            time =  curpro->enter_time;
-        int done_time = time+curpro->running_time;
-        int T_time = done_time - curpro->enter_time;
-        float QT_time = T_time / (curpro->running_time+0.0) ;
-        sum_T_time += T_time;
-        sum_QT_time += QT_time;
-        int pre = pronum;
-        for(int tt = time;tt<=done_time&&pronum<num;tt++){    //模拟进程的执行过程
-            if(tt>=pro[pronum].enter_time){ // 统计从此任务开始到结束之间有几个进程到达
-                pronum++;
+
+typedef struct Sim{
+    EventQueue events;
+    PCB* pro;          //按到达时间排好序的进程
+    int num;
+    int next;          //下一个要产生到达事件的进程
+    PCB* running;      //正在运行的进程，NULL表示CPU空闲
+    int sliceStart;    //running本次开始运行的时间
+    int quantum;       //时间片，0表示一直运行到完成
+    int gen;           //调度代数，每次调度加一
+    void* ready;       //就绪队列
+    void (*enter)(void* ready,PCB* pro);
+    PCB* (*pick)(void* ready,int time);    //取出下一个运行的进程，队列为空时返回NULL
+    void (*finish)(struct Sim* sim,PCB* pro,int done);
+    //抢占式调度：preempt(x,running)为真时就绪队列头x抢占正在运行的进程
+    PCB* (*peek)(void* ready);
+    int (*preempt)(const PCB*,const PCB*);
+    //每次调度的时间片由slice给出（NULL时用quantum），时间片用完时交给expire（NULL时用enter）
+    int (*slice)(void* ready,PCB* pro);
+    void (*expire)(void* ready,PCB* pro);
+    //每隔period调用一次boost，返回就绪队列是否还有进程
+    int period;
+    int (*boost)(struct Sim* sim);
+    int quiet;         //为真时不逐个输出进程，只统计
+    double sum_T_time;    //进程很多时float累加会丢精度
+    double sum_QT_time;
+    double sum_R_time;
+    double sum_QT2;    //带权周转时间的平方和，用于公平性指数
+    double max_QT;
+} Sim;
+
+void simInit(Sim* sim,PCB pro[],int num,void* ready,void (*enter)(void*,PCB*),
+             PCB* (*pick)(void*,int),void (*finish)(Sim*,PCB*,int),int quantum){
+    memset(sim,0,sizeof(Sim));
+    sim->pro = pro;
+    sim->num = num;
+    sim->ready = ready;
+    sim->enter = enter;
+    sim->pick = pick;
+    sim->finish = finish;
+    sim->quantum = quantum;
+    sim->quiet = quietMode;
+}
+
+void simulate(Sim* sim){
+    for(int i=0;i<sim->num;i++)
+        sim->pro[i].first_time = -1;
+    if(sim->num > 0)
+        eventPush(&sim->events,sim->pro[0].enter_time,EV_ARRIVAL,0,&sim->pro[0]);
+    sim->next = 1;
+    if(sim->num > 0 && sim->period > 0)
+        eventPush(&sim->events,sim->pro[0].enter_time+sim->period,EV_BOOST,0,NULL);
+    while(sim->events.size > 0){
+        int now = sim->events.data[0].time;
+        while(sim->events.size > 0 && sim->events.data[0].time == now){
+            Event ev = eventPop(&sim->events);
+            if(ev.type == EV_ARRIVAL){
+                sim->enter(sim->ready,ev.pro);
+                if(sim->next < sim->num){
+                    PCB* nextpro = &sim->pro[sim->next++];
+                    eventPush(&sim->events,nextpro->enter_time,EV_ARRIVAL,0,nextpro);
+                }
+            }
+            else if(ev.type == EV_BOOST){    //还有进程没完成时才安排下一次提升
+                if(sim->boost(sim) || sim->events.size > 0 || sim->running != NULL)
+                    eventPush(&sim->events,now+sim->period,EV_BOOST,0,NULL);
+            }
+            else if(ev.gen != sim->gen)    //被抢占的进程留下的事件，直接丢弃
+                continue;
+            else if(ev.type == EV_COMPLETION){
+                double QT_time = (now - ev.pro->enter_time) / (ev.pro->copyRunning_time+0.0);
+                sim->sum_QT2 += QT_time*QT_time;
+                if(QT_time > sim->max_QT)
+                    sim->max_QT = QT_time;
+                sim->finish(sim,ev.pro,now);
+                sim->running = NULL;
+            }
+            else{    //时间片用完，回到就绪队列
+                ev.pro->running_time -= now - sim->sliceStart;
+                if(sim->expire != NULL)
+                    sim->expire(sim->ready,ev.pro);
+                else
+                    sim->enter(sim->ready,ev.pro);
+                sim->running = NULL;
             }
         }
-        sortWithResponse(pro,pre,pronum);//将到达的进程按照响应时间排序
-        for(int i=pre;i<pronum;i++){    //将进程链入队列
-            EnterQueue(queue,&pro[i]);
+        if(sim->running != NULL && sim->preempt != NULL){
+            PCB* curpro = sim->running;
+            PCB* top = sim->peek(sim->ready);
+            curpro->running_time -= now - sim->sliceStart;    //running_time记剩余时间
+            sim->sliceStart = now;
+            if(top != NULL && sim->preempt(top,curpro)){
+                sim->enter(sim->ready,curpro);
+                sim->running = NULL;
+            }
         }
-        pre = pronum;
-        printf("%s\t%d\t%d\t%d\t%d\t%d\t%.2f\n",curpro->name,curpro->enter_time,curpro->running_time,time,done_time
-               ,T_time,QT_time);
-        time +=  curpro->running_time;
-        if(queue->size==0&&pronum<num){   //防止出现前一个进程执行完到下一个进程到达之间无进程进入
-            EnterQueue(queue,&pro[pronum]);
-            pronum++;
+        if(sim->running == NULL){
+            PCB* curpro = sim->pick(sim->ready,now);
+            if(curpro == NULL)
+                continue;
+            sim->running = curpro;
+            sim->sliceStart = now;
+            sim->gen++;
+            if(curpro->first_time < 0)
+                curpro->first_time = now;
+            int quantum = sim->slice != NULL ? sim->slice(sim->ready,curpro) : sim->quantum;
+            if(quantum > 0 && curpro->running_time > quantum)
+                eventPush(&sim->events,now+quantum,EV_EXPIRY,sim->gen,curpro);
+            else
+                eventPush(&sim->events,now+curpro->running_time,EV_COMPLETION,sim->gen,curpro);
         }
     }
-    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\n",sum_T_time/(num+0.0),sum_QT_time/num);
+    free(sim->events.data);
 }
 
-//按权重排序
-void sortWithPriority(PCB pro[],int start,int end){
-    int len = end - start;
-    if(len == 1) return ;
-    for(int i=1;i<len;i++){
-        for(int j= start;j<end-i;j++){
-            if(pro[j].priority>pro[j+1].priority){
-                PCB temp = pro[j];
-                pro[j] = pro[j+1];
-                pro[j+1] = temp;
-            }
-        }
+//各种就绪队列接到模拟器上
+void fifoEnter(void* ready,PCB* pro){
+    EnterQueue((PCBQueue*)ready,pro);
+}
+PCB* fifoPick(void* ready,int time){
+    (void)time;
+    PCBQueue* queue = (PCBQueue*)ready;
+    return queue->size > 0 ? poll(queue) : NULL;
+}
+void heapEnter(void* ready,PCB* pro){
+    heapPush((PCBHeap*)ready,pro);
+}
+PCB* heapPick(void* ready,int time){
+    (void)time;
+    PCBHeap* heap = (PCBHeap*)ready;
+    return heap->size > 0 ? heapPop(heap) : NULL;
+}
+PCB* heapPeek(void* ready){
+    PCBHeap* heap = (PCBHeap*)ready;
+    return heap->size > 0 ? heap->data[0] : NULL;
+}
+//键值随时间变化（响应比）时每次调度都要重新比较全部进程，堆帮不上忙，
+//这时PCBHeap只当无序数组用，进入O(1)，调度时线性扫描找最优，O(n)
+void scanEnter(void* ready,PCB* pro){
+    PCBHeap* list = (PCBHeap*)ready;
+    list->data[list->size++] = pro;
+}
+PCB* scanPick(void* ready,int time){    //先把start_time设为当前时间，再找最优的
+    PCBHeap* list = (PCBHeap*)ready;
+    if(list->size == 0)
+        return NULL;
+    int best = 0;
+    for(int k=0;k<list->size;k++){
+        list->data[k]->start_time = time;
+        if(k > 0 && heapBefore(list,list->data[k],list->data[best]))
+            best = k;
     }
+    PCB* pro = list->data[best];
+    list->data[best] = list->data[--list->size];
+    return pro;
+}
+
+//非抢占调度的进程完成：开始时间就是被调度的时间
+void finishOnce(Sim* sim,PCB* curpro,int done_time){
+    //周转时间（作业完成的时间-作业到达的时间）
+    int T_time = done_time - curpro->enter_time;
+    // 带权周转时间（（作业完成的时间-作业到达的时间）/ 作业运行时间）
+    float QT_time = T_time / (curpro->running_time+0.0) ;
+    sim->sum_T_time += T_time;
+    sim->sum_QT_time += QT_time;
+    if(!sim->quiet)
+        printf("%s\t%d\t%d\t%d\t%d\t%d\t%.2f\n",curpro->name,curpro->enter_time,curpro->running_time,sim->sliceStart,done_time
+               ,T_time,QT_time);
+}
+
+void FCFS(PCB pro[],int num){
+    if(!quietMode)
+        printf("进程 到达时间  服务时间 开始时间 完成时间 周转时间 带权周转时间\n");
+    sortWithEnterTime(pro,num);    //按照进入顺序排序
+    PCBQueue queue;
+    Queueinit(&queue);
+    Sim sim;
+    simInit(&sim,pro,num,&queue,fifoEnter,fifoPick,finishOnce,0);
+    simulate(&sim);
+    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\n",sim.sum_T_time/(num+0.0),sim.sum_QT_time/(num+0.0));
+}
+
+//非抢占的按策略调度：到达的进程进入就绪集合，CPU空闲时取最优的运行
+void heapDispatch(PCB pro[],int num,int (*before)(const PCB*,const PCB*),
+                  void (*enter)(void*,PCB*),PCB* (*pick)(void*,int)){
+    if(!quietMode)
+        printf("进程 到达时间  服务时间 开始时间 完成时间 周转时间 带权周转时间\n");
+    sortWithEnterTime(pro,num);
+    PCBHeap heap;
+    heapInit(&heap,num,before);
+    Sim sim;
+    simInit(&sim,pro,num,&heap,enter,pick,finishOnce,0);
+    simulate(&sim);
+    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\n",sim.sum_T_time/(num+0.0),sim.sum_QT_time/(num+0.0));
+    free(heap.data);
+}
+
+//按照运行时间排序
+int shorterFirst(const PCB* x,const PCB* y){
+    return x->running_time < y->running_time;
+}
+//短进程优先
+void SJF(PCB pro[],int num) {
+    heapDispatch(pro,num,shorterFirst,heapEnter,heapPick);
+}
+//计算响应比
+float responseRatio(const PCB* p){
+    return (p->start_time-p->enter_time+p->running_time)/(p->running_time+0.0);
+}
+int higherResponseFirst(const PCB* x,const PCB* y){
+    return responseRatio(x) > responseRatio(y);
+}
+//高响应比优先，响应比随等待时间变化，每次调度时线性扫描
+void HRRN(PCB pro[],int num) {
+    heapDispatch(pro,num,higherResponseFirst,scanEnter,scanPick);
+}
+
+//按权重排序
+int higherPriorityFirst(const PCB* x,const PCB* y){    //数值小的优先
+    return x->priority < y->priority;
 }
 //优先级调度算法
 void HPF(PCB pro[],int num){
-    printf("进程 到达时间  服务时间 开始时间 完成时间 周转时间 带权周转时间\n");
+    heapDispatch(pro,num,higherPriorityFirst,heapEnter,heapPick);
+}
+//抢占式调度的进程完成：running_time已减到0，服务时间取copyRunning_time
+void finishPreempt(Sim* sim,PCB* curpro,int done_time){
+    int T_time = done_time - curpro->enter_time;
+    float QT_time = T_time / (curpro->copyRunning_time+0.0);
+    int R_time = curpro->first_time - curpro->enter_time;    //响应时间
+    sim->sum_T_time += T_time;
+    sim->sum_QT_time += QT_time;
+    sim->sum_R_time += R_time;
+    if(!sim->quiet)
+            printf("%s\t%d\t%d\t%d\t%d\t%d\t%.2f\t%d\n",curpro->name,curpro->enter_time,curpro->copyRunning_time,curpro->first_time,
+               done_time,T_time,QT_time,R_time);
+}
+
+/*
+ * 抢占式的按策略调度：每个时刻的事件处理完后，若堆顶严格优于正在运行的
+ * 进程就抢占，被抢占的进程带着剩余时间回到堆里，它的完成事件由调度代数作废。
+ */
+void preemptDispatch(PCB pro[],int num,int (*before)(const PCB*,const PCB*)){
+    if(!quietMode)
+        printf("进程 到达时间  服务时间 首次运行 完成时间 周转时间 带权周转时间 响应时间\n");
     sortWithEnterTime(pro,num);
-    PCBQueue* queue = (PCBQueue*)malloc(sizeof(PCBQueue));;
-    Queueinit(queue);
-    EnterQueue(queue,&pro[0]);
-    int time = pro[0].enter_time;
-    int pronum=1;    //记录当前的进程
-    float sum_T_time = 0,sum_QT_time = 0;
-    while(queue->size>0){
-        PCB* curpro = poll(queue);   //从进程队列中取出进程
-        if(time<curpro->enter_time)
-            time =  curpro->enter_time;
-        int done_time = time+curpro->running_time;
-        int T_time = done_time - curpro->enter_time;
-        float QT_time = T_time / (curpro->running_time+0.0) ;
-        sum_T_time += T_time;
-        sum_QT_time += QT_time;
-        int pre = pronum;
-        for(int tt = time;tt<=done_time&&pronum<num;tt++){    //模拟进程的执行过程
-            if(tt>=pro[pronum].enter_time){ // 统计从此任务开始到结束之间有几个进程到达
-                pronum++;
-            }
-        }
-        sortWithPriority(pro,pre,pronum);//将到达的进程按照服务时间排序
-        for(int i=pre;i<pronum;i++){    //将进程链入队列
-            EnterQueue(queue,&pro[i]);
-        }
-        pre = pronum;
-        printf("%s\t%d\t%d\t%d\t%d\t%d\t%.2f\n",curpro->name,curpro->enter_time,curpro->running_time,time,done_time
-               ,T_time,QT_time);
-        time +=  curpro->running_time;
-        if(queue->size==0&&pronum<num){   //防止出现前一个进程执行完到下一个进程到达之间无进程进入
-            EnterQueue(queue,&pro[pronum]);
-            pronum++;
+    PCBHeap heap;
+    heapInit(&heap,num,before);
+    Sim sim;
+    simInit(&sim,pro,num,&heap,heapEnter,heapPick,finishPreempt,0);
+    sim.peek = heapPeek;
+    sim.preempt = before;
+    simulate(&sim);
+    for(int i=0;i<num;i++)    //恢复服务时间
+        pro[i].running_time = pro[i].copyRunning_time;
+    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\t平均响应时间为%.2f\n",sim.sum_T_time/(num+0.0),
+           sim.sum_QT_time/(num+0.0),sim.sum_R_time/(num+0.0));
+    free(heap.data);
+}
+//最短剩余时间优先：running_time就是剩余时间
+void SRTF(PCB pro[],int num){
+    preemptDispatch(pro,num,shorterFirst);
+}
+//抢占式优先级调度
+void PHPF(PCB pro[],int num){
+    preemptDispatch(pro,num,higherPriorityFirst);
+}
+/*
+ * 多级反馈队列：level越小优先级越高，每级一个FIFO队列和自己的时间片，
+ * nonEmpty的第l位表示第l级非空，取最高的非空级只要找最低位，与进程数无关。
+ * 用完时间片降一级，高级别的进程到达时抢占低级别的，每隔period全部提回第0级。
+ */
+#define MLFQ_MAX_LEVELS 32
+typedef struct Mlfq{
+    int levels;
+    int quantum[MLFQ_MAX_LEVELS];
+    PCBQueue queue[MLFQ_MAX_LEVELS];
+    unsigned int nonEmpty;
+    int boosts;        //提升次数
+    int maxResponse;   //最长响应时间
+    int maxWait;       //最长等待时间，衡量饥饿
+    float sumWait;
+} Mlfq;
+
+void mlfqEnter(void* ready,PCB* pro){
+    Mlfq* mlfq = (Mlfq*)ready;
+    EnterQueue(&mlfq->queue[pro->level],pro);
+    mlfq->nonEmpty |= 1u<<pro->level;
+}
+PCB* mlfqPeek(void* ready){
+    Mlfq* mlfq = (Mlfq*)ready;
+    if(mlfq->nonEmpty == 0)
+        return NULL;
+    return mlfq->queue[__builtin_ctz(mlfq->nonEmpty)].firstProg;
+}
+PCB* mlfqPick(void* ready,int time){
+    (void)time;
+    Mlfq* mlfq = (Mlfq*)ready;
+    if(mlfq->nonEmpty == 0)
+        return NULL;
+    int l = __builtin_ctz(mlfq->nonEmpty);
+    PCB* pro = poll(&mlfq->queue[l]);
+    if(mlfq->queue[l].size == 0)
+        mlfq->nonEmpty &= ~(1u<<l);
+    return pro;
+}
+int mlfqSlice(void* ready,PCB* pro){
+    return ((Mlfq*)ready)->quantum[pro->level];
+}
+void mlfqExpire(void* ready,PCB* pro){    //用完时间片降一级，最低级内部轮转
+    if(pro->level < ((Mlfq*)ready)->levels-1)
+        pro->level++;
+    mlfqEnter(ready,pro);
+}
+int mlfqPreempt(const PCB* x,const PCB* y){
+    return x->level < y->level;
+}
+//把低级队列按级别顺序整条接到第0级后面，保持各级内部的先后顺序
+int mlfqBoost(Sim* sim){
+    Mlfq* mlfq = (Mlfq*)sim->ready;
+    PCBQueue* top = &mlfq->queue[0];
+    mlfq->boosts++;
+    if(sim->running != NULL)
+        sim->running->level = 0;
+    for(int l=1;l<mlfq->levels;l++){
+        PCBQueue* queue = &mlfq->queue[l];
+        if(queue->size == 0)
+            continue;
+        for(PCB* p=queue->firstProg;p!=NULL;p=p->next)
+            p->level = 0;
+        if(top->LastProg == NULL)
+            top->firstProg = queue->firstProg;
+        else
+            top->LastProg->next = queue->firstProg;
+        top->LastProg = queue->LastProg;
+        top->size += queue->size;
+        Queueinit(queue);
+    }
+    mlfq->nonEmpty = top->size > 0 ? 1u : 0;
+    return mlfq->nonEmpty != 0;
+}
+void finishMlfq(Sim* sim,PCB* curpro,int done_time){
+    Mlfq* mlfq = (Mlfq*)sim->ready;
+    int R_time = curpro->first_time - curpro->enter_time;
+    int W_time = done_time - curpro->enter_time - curpro->copyRunning_time;    //在就绪队列里等待的总时间
+    finishPreempt(sim,curpro,done_time);
+    mlfq->sumWait += W_time;
+    if(R_time > mlfq->maxResponse)
+        mlfq->maxResponse = R_time;
+    if(W_time > mlfq->maxWait)
+        mlfq->maxWait = W_time;
+}
+//多级反馈队列调度
+void MLFQ(PCB pro[],int num){
+    Mlfq mlfq;
+    memset(&mlfq,0,sizeof(Mlfq));
+    ask("请输入队列级数(1-%d)",MLFQ_MAX_LEVELS);
+    readInt(&mlfq.levels);
+    if(mlfq.levels < 1 || mlfq.levels > MLFQ_MAX_LEVELS){
+        printf("队列级数必须在1到%d之间\n",MLFQ_MAX_LEVELS);
+        return;
+    }
+    ask("请从高到低输入各级的时间片");
+    for(int l=0;l<mlfq.levels;l++){
+        readInt(&mlfq.quantum[l]);
+        if(mlfq.quantum[l] <= 0){
+            printf("时间片必须为正数\n");
+            return;
         }
     }
-    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\n",sum_T_time/(num+0.0),sum_QT_time/(num+0.0));
+    int period;
+    ask("请输入优先级提升周期（0表示不提升）");
+    readInt(&period);
+    if(period < 0){
+        printf("提升周期不能为负数\n");
+        return;
+    }
+    if(!quietMode)
+        printf("进程 到达时间  服务时间 首次运行 完成时间 周转时间 带权周转时间 响应时间\n");
+    sortWithEnterTime(pro,num);
+    for(int l=0;l<mlfq.levels;l++)
+        Queueinit(&mlfq.queue[l]);
+    for(int i=0;i<num;i++)    //新到达的进程从最高级开始
+        pro[i].level = 0;
+    Sim sim;
+    simInit(&sim,pro,num,&mlfq,mlfqEnter,mlfqPick,finishMlfq,0);
+    sim.peek = mlfqPeek;
+    sim.preempt = mlfqPreempt;
+    sim.slice = mlfqSlice;
+    sim.expire = mlfqExpire;
+    sim.period = period;
+    sim.boost = mlfqBoost;
+    simulate(&sim);
+    for(int i=0;i<num;i++)    //恢复服务时间
+        pro[i].running_time = pro[i].copyRunning_time;
+    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\t平均响应时间为%.2f\n",sim.sum_T_time/(num+0.0),
+           sim.sum_QT_time/(num+0.0),sim.sum_R_time/(num+0.0));
+    printf("最长响应时间为%d\t平均等待时间为%.2f\t最长等待时间为%d\t优先级提升%d次\n\n",mlfq.maxResponse,
+           mlfq.sumWait/(num+0.0),mlfq.maxWait,mlfq.boosts);
+}
+/*
+ * 完全公平调度：总是运行虚拟运行时间最小的进程。进程实际运行t，
+ * vruntime增加t*1024/权重，优先级当作nice值（夹到-20..19）查权重表，
+ * 数值小的权重大、vruntime涨得慢，分到的CPU就多。
+ * 时间片为latency按权重占比分得的份额，但不小于最小粒度minGran。
+ * 就绪进程按vruntime放在堆里，取最小和插入都是O(log n)。
+ */
+#define NICE_0_WEIGHT 1024
+static const int niceToWeight[40] = {
+    88761, 71755, 56483, 46273, 36291,
+    29154, 23254, 18705, 14949, 11916,
+    9548,  7620,  6100,  4904,  3906,
+    3121,  2501,  1991,  1586,  1277,
+    1024,  820,   655,   526,   423,
+    335,   272,   215,   172,   137,
+    110,   87,    70,    56,    45,
+    36,    29,    23,    18,    15,
+};
+int cfsWeight(const PCB* pro){
+    int nice = pro->priority < -20 ? -20 : (pro->priority > 19 ? 19 : pro->priority);
+    return niceToWeight[nice+20];
+}
+typedef struct Cfs{
+    PCBHeap heap;
+    int latency;            //调度周期
+    int minGran;            //最小粒度
+    long long minVruntime;  //单调不减，新到达的进程从这里开始
+    long long totalWeight;  //就绪和正在运行的进程的权重和
+    int curSlice;           //正在运行的进程分到的时间片
+} Cfs;
+
+int smallerVruntime(const PCB* x,const PCB* y){
+    return x->vruntime < y->vruntime;
+}
+void cfsEnter(void* ready,PCB* pro){    //新到达：不能落后于minVruntime，否则会长期独占CPU
+    Cfs* cfs = (Cfs*)ready;
+    if(pro->vruntime < cfs->minVruntime)
+        pro->vruntime = cfs->minVruntime;
+    cfs->totalWeight += cfsWeight(pro);
+    heapPush(&cfs->heap,pro);
+}
+PCB* cfsPick(void* ready,int time){
+    (void)time;
+    Cfs* cfs = (Cfs*)ready;
+    if(cfs->heap.size == 0)
+        return NULL;
+    PCB* pro = heapPop(&cfs->heap);
+    if(pro->vruntime > cfs->minVruntime)
+        cfs->minVruntime = pro->vruntime;
+    return pro;
+}
+int cfsSlice(void* ready,PCB* pro){
+    Cfs* cfs = (Cfs*)ready;
+    long long slice = cfs->latency * (long long)cfsWeight(pro) / cfs->totalWeight;
+    cfs->curSlice = slice < cfs->minGran ? cfs->minGran : (int)slice;
+    return cfs->curSlice;
+}
+void cfsExpire(void* ready,PCB* pro){    //不抢占，用完时间片才回到堆里，实际运行的就是curSlice
+    Cfs* cfs = (Cfs*)ready;
+    pro->vruntime += (long long)cfs->curSlice * NICE_0_WEIGHT * 1024 / cfsWeight(pro);
+    heapPush(&cfs->heap,pro);
+    if(cfs->heap.data[0]->vruntime > cfs->minVruntime)
+        cfs->minVruntime = cfs->heap.data[0]->vruntime;
+}
+void finishCfs(Sim* sim,PCB* curpro,int done_time){
+    ((Cfs*)sim->ready)->totalWeight -= cfsWeight(curpro);
+    finishPreempt(sim,curpro,done_time);
+}
+//读入调度周期和最小粒度，不合法时返回0
+int inputCfs(Cfs* cfs){
+    ask("请输入调度周期和最小粒度");
+    readInt(&cfs->latency);
+    readInt(&cfs->minGran);
+    if(cfs->latency <= 0 || cfs->minGran <= 0){
+        printf("调度周期和最小粒度必须为正数\n");
+        return 0;
+    }
+    return 1;
+}
+void cfsSim(Sim* sim,Cfs* cfs,PCB pro[],int num){
+    heapInit(&cfs->heap,num,smallerVruntime);
+    cfs->minVruntime = 0;
+    cfs->totalWeight = 0;
+    for(int i=0;i<num;i++)
+        pro[i].vruntime = 0;
+    simInit(sim,pro,num,cfs,cfsEnter,cfsPick,finishCfs,0);
+    sim->slice = cfsSlice;
+    sim->expire = cfsExpire;
+}
+//完全公平调度
+void CFS(PCB pro[],int num){
+    Cfs cfs;
+    if(!inputCfs(&cfs))
+        return;
+    if(!quietMode)
+        printf("进程 到达时间  服务时间 首次运行 完成时间 周转时间 带权周转时间 响应时间\n");
+    sortWithEnterTime(pro,num);
+    Sim sim;
+    cfsSim(&sim,&cfs,pro,num);
+    simulate(&sim);
+    for(int i=0;i<num;i++)    //恢复服务时间
+        pro[i].running_time = pro[i].copyRunning_time;
+    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\t平均响应时间为%.2f\n\n",sim.sum_T_time/(num+0.0),
+           sim.sum_QT_time/(num+0.0),sim.sum_R_time/(num+0.0));
+    free(cfs.heap.data);
+}
+//时间片轮转的进程完成：start_time是进入队列的时间
+void finishRR(Sim* sim,PCB* curpro,int done_time){
+    curpro->running_time = 0;
+    curpro->done_time = done_time;
+    int T_time = curpro->done_time-curpro->start_time;
+    float QT_time = T_time / (curpro->copyRunning_time+0.0);
+    sim->sum_T_time += T_time;
+    sim->sum_QT_time += QT_time;
+    if(!sim->quiet)
+        printf("%s\t%d\t%d\t  %d\t   %d\t %d\t  %.2f\n",curpro->name,curpro->enter_time,curpro->copyRunning_time,
+               curpro->start_time,curpro->done_time,T_time,QT_time);
 }
 //时间片轮转调度
 void RR(PCB pro[],int num){
-    printf("请输入时间片大小");
+    ask("请输入时间片大小");
     int timeslice;
-    scanf("%d",&timeslice);
-    printf("进程 到达时间 服务时间 进入时间 完成时间 周转时间 带权周转时间\n");
+    readInt(&timeslice);
+    if(timeslice <= 0){
+        printf("时间片必须为正数\n");
+        return;
+    }
+    if(!quietMode)
+        printf("进程 到达时间 服务时间 进入时间 完成时间 周转时间 带权周转时间\n");
     sortWithEnterTime(pro,num);
-    PCBQueue* queue = (PCBQueue*)malloc(sizeof(PCBQueue));;
-    Queueinit(queue);
-    //第一个进程开始运行的时间就是到达时间
-    pro[0].start_time = pro[0].enter_time;
-    EnterQueue(queue,&pro[0]);
-    int time = 0;
-    int pronum = 1;
-    float sum_T_time = 0,sum_QT_time = 0;
-    while(queue->size>0){
-        PCB* curpro = poll(queue);    // 从队列中取出头节点
-        if(time<curpro->enter_time)
-            time = curpro->enter_time;
-        if(timeslice >= curpro->running_time){   // 如果剩余时间小于时间片  则此任务完成
-            for(int tt = time;tt<=time+curpro->running_time&&pronum<num;tt++){    // 模拟进程的执行过程
-                if(tt>=pro[pronum].enter_time){ // 统计从此任务开始到结束之间有几个进程到达
-                    pro[pronum].start_time = tt;
-                    EnterQueue(queue,&pro[pronum]);
-                    pronum++;
+    PCBQueue queue;
+    Queueinit(&queue);
+    for(int i=0;i<num;i++)    //进程在到达时进入队列
+        pro[i].start_time = pro[i].enter_time;
+    Sim sim;
+    simInit(&sim,pro,num,&queue,fifoEnter,fifoPick,finishRR,timeslice);
+    simulate(&sim);
+    for(int i=0;i<num;i++)    //队列直接链接pro[]，恢复被时间片消耗掉的服务时间
+        pro[i].running_time = pro[i].copyRunning_time;
+    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\n\n",sim.sum_T_time/(num+0.0),sim.sum_QT_time/(num+0.0));
+}
+/*
+ * 多核调度：每个核有自己的FIFO就绪队列，时间片轮转（时间片为0时一直运行到完成）。
+ * 到达的进程按place分到某个核：轮流分配，或放到就绪加运行最少的核。
+ * steal为真时空闲核从队列最长的核取走队头；period>0时每隔period把最长队列的
+ * 队头挪到最短队列，直到相差不超过1。进程换核运行时服务时间加上迁移开销migrate。
+ */
+#define PLACE_ROUND 0
+#define PLACE_SHORTEST 1
+typedef struct Smp{
+    EventQueue events;
+    PCB* pro;
+    int num;
+    int next;
+    int cores;
+    int quantum;
+    int place;
+    int steal;
+    int period;
+    int migrate;
+    PCBQueue* queue;     //每个核的就绪队列
+    PCB** running;       //每个核正在运行的进程
+    int* sliceStart;
+    long long* busy;     //每个核的忙碌时间，包括迁移开销
+    int makespan;
+    int migrations;
+    int steals;
+    int moves;           //负载均衡挪动的次数
+    double sum_T_time;
+    double sum_QT_time;
+} Smp;
+
+int smpLoad(Smp* smp,int c){
+    return smp->queue[c].size + (smp->running[c] != NULL);
+}
+//就绪队列最长的核，都为空时返回-1
+int smpLongest(Smp* smp){
+    int best = -1;
+    for(int c=0;c<smp->cores;c++)
+        if(smp->queue[c].size > 0 && (best < 0 || smp->queue[c].size > smp->queue[best].size))
+            best = c;
+    return best;
+}
+void smpPlace(Smp* smp,PCB* pro,int k){
+    int target = 0;
+    if(smp->place == PLACE_ROUND)
+        target = k % smp->cores;
+    else
+        for(int c=1;c<smp->cores;c++)
+            if(smpLoad(smp,c) < smpLoad(smp,target))
+                target = c;
+    EnterQueue(&smp->queue[target],pro);
+}
+//还有进程没完成时返回真
+int smpBalance(Smp* smp){
+    int pending = 0;
+    while(1){
+        int hi = 0,lo = 0;
+        for(int c=1;c<smp->cores;c++){
+            if(smp->queue[c].size > smp->queue[hi].size) hi = c;
+            if(smp->queue[c].size < smp->queue[lo].size) lo = c;
+        }
+        if(smp->queue[hi].size - smp->queue[lo].size <= 1)
+            break;
+        EnterQueue(&smp->queue[lo],poll(&smp->queue[hi]));
+        smp->moves++;
+    }
+    for(int c=0;c<smp->cores;c++)
+        pending += smpLoad(smp,c);
+    return pending > 0;
+}
+void smpDispatch(Smp* smp,int c,int now){
+    PCB* curpro = NULL;
+    if(smp->queue[c].size > 0)
+        curpro = poll(&smp->queue[c]);
+    else if(smp->steal){
+        int victim = smpLongest(smp);
+        if(victim < 0)
+            return;
+        curpro = poll(&smp->queue[victim]);
+        smp->steals++;
+    }
+    if(curpro == NULL)
+        return;
+    if(curpro->core >= 0 && curpro->core != c){    //换核运行，缓存要重新预热
+        curpro->running_time += smp->migrate;
+        smp->migrations++;
+    }
+    curpro->core = c;
+    smp->running[c] = curpro;
+    smp->sliceStart[c] = now;
+    if(smp->quantum > 0 && curpro->running_time > smp->quantum)
+        eventPush(&smp->events,now+smp->quantum,EV_EXPIRY,0,curpro);
+    else
+        eventPush(&smp->events,now+curpro->running_time,EV_COMPLETION,0,curpro);
+}
+void smpFinish(Smp* smp,PCB* curpro,int done_time){
+    int T_time = done_time - curpro->enter_time;
+    float QT_time = T_time / (curpro->copyRunning_time+0.0);
+    smp->sum_T_time += T_time;
+    smp->sum_QT_time += QT_time;
+    if(done_time > smp->makespan)
+        smp->makespan = done_time;
+    if(!quietMode)
+        printf("%s\t%d\t%d\t%d\t%d\t%d\t%.2f\n",curpro->name,curpro->enter_time,curpro->copyRunning_time,curpro->core,
+               done_time,T_time,QT_time);
+}
+//没有抢占，完成和到期事件都不会作废，事件里的进程记着所在的核
+void smpSimulate(Smp* smp){
+    if(smp->num > 0)
+        eventPush(&smp->events,smp->pro[0].enter_time,EV_ARRIVAL,0,&smp->pro[0]);
+    if(smp->num > 0 && smp->period > 0)
+        eventPush(&smp->events,smp->pro[0].enter_time+smp->period,EV_BALANCE,0,NULL);
+    smp->next = 1;
+    while(smp->events.size > 0){
+        int now = smp->events.data[0].time;
+        while(smp->events.size > 0 && smp->events.data[0].time == now){
+            Event ev = eventPop(&smp->events);
+            if(ev.type == EV_ARRIVAL){
+                smpPlace(smp,ev.pro,smp->next-1);
+                if(smp->next < smp->num){
+                    PCB* nextpro = &smp->pro[smp->next++];
+                    eventPush(&smp->events,nextpro->enter_time,EV_ARRIVAL,0,nextpro);
                 }
             }
-            time += curpro->running_time;
-            curpro->running_time = 0;
-            curpro->done_time = time;
-            int T_time = curpro->done_time-curpro->start_time;
-            float QT_time = T_time / (curpro->copyRunning_time+0.0);
-            sum_T_time += T_time;
-            sum_QT_time += QT_time;
-            printf("%s\t%d\t%d\t  %d\t   %d\t %d\t  %.2f\n",curpro->name,curpro->enter_time,curpro->copyRunning_time,
-                   curpro->start_time,curpro->done_time,T_time,QT_time);
-            if(queue->size==0&&pronum<num){   //防止出现前一个进程执行完到下一个进程到达之间无进程进入
-                pro[pronum].start_time = pro[pronum].enter_time;
-                EnterQueue(queue,&pro[pronum]);
-                pronum++;
+            else if(ev.type == EV_BALANCE){
+                if(smpBalance(smp) || smp->events.size > 0)
+                    eventPush(&smp->events,now+smp->period,EV_BALANCE,0,NULL);
             }
-            continue;
-        }
-        // 运行时间大于时间片
-        for(int tt = time;tt<=time+timeslice&&pronum<num;tt++){    //模拟进程的执行过程
-            if(tt>=pro[pronum].enter_time){ // 统计从此任务开始到结束之间有几个进程到达
-                pro[pronum].start_time = tt;
-                EnterQueue(queue,&pro[pronum]);
-                pronum++;
+            else{
+                int c = ev.pro->core;
+                smp->busy[c] += now - smp->sliceStart[c];
+                smp->running[c] = NULL;
+                if(ev.type == EV_COMPLETION)
+                    smpFinish(smp,ev.pro,now);
+                else{
+                    ev.pro->running_time -= now - smp->sliceStart[c];
+                    EnterQueue(&smp->queue[c],ev.pro);
+                }
             }
         }
-        time += timeslice;
-        curpro->running_time -= timeslice;
-        //当前程序未完成  继续添加到队列中
-        EnterQueue(queue,curpro);
-        if(queue->size==0&&pronum<num){   //防止出现前一个进程执行完到下一个进程到达之间无进程进入
-            pro[pronum].start_time = pro[pronum].enter_time;
-            EnterQueue(queue,&pro[pronum]);
-            pronum++;
-        }
+        for(int c=0;c<smp->cores;c++)
+            if(smp->running[c] == NULL)
+                smpDispatch(smp,c,now);
     }
-    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\n\n",sum_T_time/(num+0.0),sum_QT_time/(num+0.0));
+    free(smp->events.data);
+}
+//多核调度
+void SMP(PCB pro[],int num){
+    Smp smp;
+    memset(&smp,0,sizeof(Smp));
+    ask("请输入核数、时间片（0表示运行到完成）");
+    readInt(&smp.cores);
+    readInt(&smp.quantum);
+    ask("请输入分配方式（0轮流，1最短队列）、是否窃取（0/1）、均衡周期（0表示不均衡）、迁移开销");
+    readInt(&smp.place);
+    readInt(&smp.steal);
+    readInt(&smp.period);
+    readInt(&smp.migrate);
+    if(smp.cores <= 0 || smp.quantum < 0 || smp.period < 0 || smp.migrate < 0
+       || (smp.place != PLACE_ROUND && smp.place != PLACE_SHORTEST)){
+        printf("参数不合法\n");
+        return;
+    }
+    if(!quietMode)
+        printf("进程 到达时间  服务时间 完成所在核 完成时间 周转时间 带权周转时间\n");
+    sortWithEnterTime(pro,num);
+    for(int i=0;i<num;i++)
+        pro[i].core = -1;
+    smp.pro = pro;
+    smp.num = num;
+    smp.queue = (PCBQueue*)malloc(smp.cores*sizeof(PCBQueue));
+    smp.running = (PCB**)calloc(smp.cores,sizeof(PCB*));
+    smp.sliceStart = (int*)calloc(smp.cores,sizeof(int));
+    smp.busy = (long long*)calloc(smp.cores,sizeof(long long));
+    for(int c=0;c<smp.cores;c++)
+        Queueinit(&smp.queue[c]);
+    smpSimulate(&smp);
+    for(int i=0;i<num;i++)    //恢复服务时间
+        pro[i].running_time = pro[i].copyRunning_time;
+    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\t完成时间为%d\n",smp.sum_T_time/(num+0.0),
+           smp.sum_QT_time/(num+0.0),smp.makespan);
+    for(int c=0;c<smp.cores;c++)
+        printf("核%d\t忙碌%lld\t利用率%.2f%%\n",c,smp.busy[c],smp.makespan > 0 ? smp.busy[c]*100.0/smp.makespan : 0.0);
+    printf("迁移%d次\t窃取%d次\t均衡挪动%d次\n\n",smp.migrations,smp.steals,smp.moves);
+    free(smp.queue);
+    free(smp.running);
+    free(smp.sliceStart);
+    free(smp.busy);
+}
+//比较时输出一行：Jain公平性指数按各进程的带权周转时间计算，1表示完全公平
+void compareReport(const char* name,Sim* sim,int num,double seconds){
+    double fair = sim->sum_QT2 > 0 ? (double)sim->sum_QT_time*sim->sum_QT_time/(num*sim->sum_QT2) : 1.0;
+    printf("%s\t%d\t%.1f\t%.1f\t%.2f\t%.2f\t%.4f\t%.2f\n",name,sim->gen,seconds*1000,
+           sim->gen > 0 ? seconds*1e9/sim->gen : 0.0,sim->sum_T_time/(num+0.0),sim->sum_QT_time/(num+0.0),fair,sim->max_QT);
+}
+//不逐个输出进程，比较时间片轮转、优先级调度和完全公平调度的公平性与调度开销
+void compareFair(PCB pro[],int num){
+    ask("请输入时间片大小");
+    int timeslice;
+    readInt(&timeslice);
+    if(timeslice <= 0){
+        printf("时间片必须为正数\n");
+        return;
+    }
+    Cfs cfs;
+    if(!inputCfs(&cfs))
+        return;
+    sortWithEnterTime(pro,num);
+    printf("算法\t调度次数\t耗时(ms)\t每次调度(ns)\t平均周转时间\t平均带权周转时间\t公平性指数\t最大带权周转时间\n");
+    Sim sim;
+    clock_t begin;
+
+    PCBQueue queue;
+    Queueinit(&queue);
+    for(int i=0;i<num;i++)
+        pro[i].start_time = pro[i].enter_time;
+    simInit(&sim,pro,num,&queue,fifoEnter,fifoPick,finishRR,timeslice);
+    sim.quiet = 1;
+    begin = clock();
+    simulate(&sim);
+    compareReport("RR",&sim,num,(clock()-begin)/(double)CLOCKS_PER_SEC);
+    for(int i=0;i<num;i++)
+        pro[i].running_time = pro[i].copyRunning_time;
+
+    PCBHeap heap;
+    heapInit(&heap,num,higherPriorityFirst);
+    simInit(&sim,pro,num,&heap,heapEnter,heapPick,finishOnce,0);
+    sim.quiet = 1;
+    begin = clock();
+    simulate(&sim);
+    compareReport("HPF",&sim,num,(clock()-begin)/(double)CLOCKS_PER_SEC);
+    free(heap.data);
+
+    cfsSim(&sim,&cfs,pro,num);
+    sim.quiet = 1;
+    begin = clock();
+    simulate(&sim);
+    compareReport("CFS",&sim,num,(clock()-begin)/(double)CLOCKS_PER_SEC);
+    for(int i=0;i<num;i++)
+        pro[i].running_time = pro[i].copyRunning_time;
+    free(cfs.heap.data);
+    printf("\n");
 }
 void choiceMenu(){
     printf("请选择进程调度算法：\n\n");
-    printf("1.先来先服务算法\n2.短进程优先算法\n3.高优先级优先\n4.时间片轮转算法\n5.高响应比优先算法\n6.退出\n");
+    printf("1.先来先服务算法\n2.短进程优先算法\n3.高优先级优先\n4.时间片轮转算法\n5.高响应比优先算法\n6.退出\n7.最短剩余时间优先（抢占式）\n8.抢占式优先级调度\n9.多级反馈队列调度\n10.完全公平调度\n11.比较时间片轮转、优先级调度和完全公平调度\n12.多核调度\n");
 }
 void menu(){
     int proNum;
     printf("请输入进程的个数：");
     scanf("%d",&proNum);
-    PCB pro[proNum];
+    if(proNum <= 0){
+        printf("进程个数必须为正数\n");
+        return;
+    }
+    PCB* pro = (PCB*)malloc(proNum*sizeof(PCB));    //放在堆上，进程很多时不会撑爆栈
     inputPCB(pro,proNum);
     choiceMenu();
     int choice;
@@ -379,11 +1075,271 @@ void menu(){
             case 3:HPF(pro,proNum);choiceMenu();break;
             case 4:RR(pro,proNum);choiceMenu();break;
             case 5:HRRN(pro,proNum);choiceMenu();break;
-            case 6:return;
+            case 6:free(pro);return;
+            case 7:SRTF(pro,proNum);choiceMenu();break;
+            case 8:PHPF(pro,proNum);choiceMenu();break;
+            case 9:MLFQ(pro,proNum);choiceMenu();break;
+            case 10:CFS(pro,proNum);choiceMenu();break;
+            case 11:compareFair(pro,proNum);choiceMenu();break;
+            case 12:SMP(pro,proNum);choiceMenu();break;
+        }
+    }
+}
+/*
+ * 作业轨迹：CSV每行“名字,到达时间,服务时间,优先级”，#开头的行是注释；
+ * 二进制文件以TraceHeader开头，后面是count个TraceRecord。读入时按魔数区分。
+ */
+typedef struct TraceHeader{
+    char magic[8];    //"PCBTRACE"
+    int count;
+    int reserved;
+} TraceHeader;
+typedef struct TraceRecord{
+    char name[20];
+    int enter_time;
+    int running_time;
+    int priority;
+} TraceRecord;
+
+//读入轨迹文件，进程放在堆上，失败时返回NULL
+PCB* loadTrace(const char* path,int* num){
+    FILE* fp = fopen(path,"rb");
+    if(fp == NULL){
+        perror(path);
+        return NULL;
+    }
+    TraceHeader head;
+    PCB* pro = NULL;
+    int n = 0,cap = 0;
+    if(fread(&head,sizeof(head),1,fp) == 1 && memcmp(head.magic,"PCBTRACE",8) == 0){
+        if(head.count < 0){
+            fprintf(stderr,"%s: 进程个数不合法\n",path);
+            fclose(fp);
+            return NULL;
+        }
+        pro = (PCB*)malloc((head.count > 0 ? head.count : 1)*sizeof(PCB));
+        TraceRecord rec;
+        while(n < head.count && fread(&rec,sizeof(rec),1,fp) == 1){
+            memcpy(pro[n].name,rec.name,sizeof(pro[n].name));
+            pro[n].name[sizeof(pro[n].name)-1] = '\0';
+            pro[n].enter_time = rec.enter_time;
+            pro[n].running_time = rec.running_time;
+            pro[n].priority = rec.priority;
+            n++;
+        }
+        if(n < head.count){
+            fprintf(stderr,"%s: 文件不完整，只读到%d个进程\n",path,n);
+            free(pro);
+            fclose(fp);
+            return NULL;
+        }
+    }
+    else{
+        rewind(fp);
+        char line[256];
+        int lineNo = 0;
+        while(fgets(line,sizeof(line),fp) != NULL){
+            lineNo++;
+            if(line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+                continue;
+            if(n == cap){
+                cap = cap ? 2*cap : 1024;
+                pro = (PCB*)realloc(pro,cap*sizeof(PCB));
+            }
+            PCB* prog = &pro[n];
+            if(sscanf(line," %19[^,],%d,%d,%d",prog->name,&prog->enter_time,&prog->running_time,&prog->priority) != 4){
+                fprintf(stderr,"%s:%d: 格式应为 名字,到达时间,服务时间,优先级\n",path,lineNo);
+                free(pro);
+                fclose(fp);
+                return NULL;
+            }
+            n++;
+        }
+    }
+    fclose(fp);
+    for(int i=0;i<n;i++){
+        if(pro[i].running_time <= 0){
+            fprintf(stderr,"%s: 进程%s的服务时间必须为正数\n",path,pro[i].name);
+            free(pro);
+            return NULL;
+        }
+        pro[i].copyRunning_time = pro[i].running_time;
+    }
+    *num = n;
+    return pro;
+}
+
+//写出轨迹文件，以.bin结尾时写二进制，否则写CSV
+int saveTrace(const char* path,PCB pro[],int num){
+    size_t len = strlen(path);
+    int binary = len >= 4 && strcmp(path+len-4,".bin") == 0;
+    FILE* fp = fopen(path,binary ? "wb" : "w");
+    if(fp == NULL){
+        perror(path);
+        return 0;
+    }
+    if(binary){
+        TraceHeader head;
+        memset(&head,0,sizeof(head));
+        memcpy(head.magic,"PCBTRACE",8);
+        head.count = num;
+        fwrite(&head,sizeof(head),1,fp);
+        for(int i=0;i<num;i++){
+            TraceRecord rec;
+            memset(&rec,0,sizeof(rec));
+            memcpy(rec.name,pro[i].name,sizeof(rec.name));
+            rec.enter_time = pro[i].enter_time;
+            rec.running_time = pro[i].copyRunning_time;
+            rec.priority = pro[i].priority;
+            fwrite(&rec,sizeof(rec),1,fp);
+        }
+    }
+    else{
+        fprintf(fp,"#名字,到达时间,服务时间,优先级\n");
+        for(int i=0;i<num;i++)
+            fprintf(fp,"%s,%d,%d,%d\n",pro[i].name,pro[i].enter_time,pro[i].copyRunning_time,pro[i].priority);
+    }
+    return fclose(fp) == 0;
+}
+
+/*
+ * 生成作业：到达是速率为rate的泊松过程（间隔服从指数分布），
+ * 服务时间服从最小值为minRun、形状为alpha的帕累托分布（重尾，alpha越小尾巴越重），
+ * 优先级在[0,levels)中均匀选取。同一个种子总是生成同样的作业。
+ */
+unsigned long long genNext(unsigned long long* s){    //xorshift64*
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * 0x2545f4914f6cdd1dULL;
+}
+double genReal(unsigned long long* s){    //(0,1)
+    return ((genNext(s) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+PCB* generate(int num,unsigned long long seed,double rate,double alpha,int minRun,int levels){
+    PCB* pro = (PCB*)malloc(num*sizeof(PCB));
+    unsigned long long s = seed ? seed : 0x9e3779b97f4a7c15ULL;    //xorshift的状态不能为0
+    double now = 0;
+    for(int i=0;i<num;i++){
+        now += -log(genReal(&s)) / rate;
+        double run = minRun * pow(genReal(&s),-1.0/alpha);    //反函数法
+        snprintf(pro[i].name,sizeof(pro[i].name),"p%d",i);
+        pro[i].enter_time = now < 1e9 ? (int)now : 1000000000;
+        pro[i].running_time = run < 1e7 ? (int)run : 10000000;    //截断极端的尾巴
+        pro[i].copyRunning_time = pro[i].running_time;
+        pro[i].priority = (int)(genNext(&s) % levels);
+    }
+    return pro;
+}
+
+/*
+ * 事件时间是int：最晚到达时间加上全部服务时间就是任何策略下最晚的完成时间，
+ * 超过TIME_LIMIT时拒绝模拟，留出的余量给时间片到期、提升和迁移开销。
+ */
+#define TIME_LIMIT 1000000000
+int spanOk(PCB pro[],int num){
+    long long last = 0,total = 0;
+    for(int i=0;i<num;i++){
+        if(pro[i].enter_time < 0 || pro[i].enter_time > TIME_LIMIT){
+            fprintf(stderr,"进程%s的到达时间必须在0到%d之间\n",pro[i].name,TIME_LIMIT);
+            return 0;
         }
+        if(pro[i].enter_time > last)
+            last = pro[i].enter_time;
+        total += pro[i].copyRunning_time;
+    }
+    if(last + total > TIME_LIMIT){
+        fprintf(stderr,"最晚到达时间加总服务时间为%lld，超过%d，请减少进程个数、调小服务时间或调大到达速率\n",
+                last+total,TIME_LIMIT);
+        return 0;
     }
+    return 1;
 }
-int main(){
-    menu();
+
+typedef struct Policy{
+    const char* name;
+    void (*run)(PCB pro[],int num);
+} Policy;
+static const Policy policies[] = {
+    {"fcfs",FCFS},{"sjf",SJF},{"hpf",HPF},{"rr",RR},{"hrrn",HRRN},{"srtf",SRTF},{"phpf",PHPF},
+    {"mlfq",MLFQ},{"cfs",CFS},{"compare",compareFair},{"smp",SMP},
+};
+
+void usage(const char* prog){
+    fprintf(stderr,"用法：%s                      交互式输入进程\n"
+                   "      %s -f 轨迹文件 [选项]   从CSV或二进制轨迹读入进程\n"
+                   "      %s -g 个数 [选项]       生成进程\n"
+                   "  -S 种子 -r 到达速率 -a 帕累托形状 -m 最小服务时间 -l 优先级个数  生成参数\n"
+                   "  -o 文件  写出轨迹（.bin为二进制，否则为CSV）\n"
+                   "  -p 算法  fcfs sjf hpf rr hrrn srtf phpf mlfq cfs compare smp\n"
+                   "  -x 参数  按交互时的提示顺序给出算法参数，如 -p mlfq -x \"3 2 4 8 100\"\n"
+                   "  -q       不输出表头和每个进程的结果\n",prog,prog,prog);
+}
+
+int main(int argc,char* argv[]){
+    if(argc == 1){
+        menu();
+        return 0;
+    }
+    const char* tracePath = NULL;
+    const char* outPath = NULL;
+    const char* policyName = NULL;
+    int genNum = 0,minRun = 1,levels = 10;
+    unsigned long long seed = 1;
+    double rate = 0.1,alpha = 1.5;
+    int opt;
+    while((opt = getopt(argc,argv,"f:g:S:r:a:m:l:o:p:x:q")) != -1){
+        switch(opt){
+            case 'f':tracePath = optarg;break;
+            case 'g':genNum = atoi(optarg);break;
+            case 'S':seed = strtoull(optarg,NULL,10);break;
+            case 'r':rate = atof(optarg);break;
+            case 'a':alpha = atof(optarg);break;
+            case 'm':minRun = atoi(optarg);break;
+            case 'l':levels = atoi(optarg);break;
+            case 'o':outPath = optarg;break;
+            case 'p':policyName = optarg;break;
+            case 'x':paramText = optarg;break;
+            case 'q':quietMode = 1;break;
+            default:usage(argv[0]);return 1;
+        }
+    }
+    if((tracePath == NULL) == (genNum <= 0) || rate <= 0 || alpha <= 0 || minRun <= 0 || levels <= 0){
+        usage(argv[0]);
+        return 1;
+    }
+    const Policy* policy = NULL;
+    if(policyName != NULL){
+        for(size_t k=0;k<sizeof(policies)/sizeof(policies[0]);k++)
+            if(strcmp(policies[k].name,policyName) == 0)
+                policy = &policies[k];
+        if(policy == NULL){
+            fprintf(stderr,"未知的算法%s\n",policyName);
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if(paramText == NULL)    //命令行模式不从标准输入读参数
+        paramText = "";
+    int num = genNum;
+    PCB* pro = tracePath != NULL ? loadTrace(tracePath,&num) : generate(genNum,seed,rate,alpha,minRun,levels);
+    if(pro == NULL)
+        return 1;
+    if(num == 0){
+        fprintf(stderr,"没有进程\n");
+        free(pro);
+        return 1;
+    }
+    if(policy != NULL && !spanOk(pro,num)){
+        free(pro);
+        return 1;
+    }
+    if(outPath != NULL && !saveTrace(outPath,pro,num)){
+        free(pro);
+        return 1;
+    }
+    if(policy != NULL)
+        policy->run(pro,num);
+    free(pro);
     return 0;
 }
@@ -31,32 +31,26 @@ void Queueinit(PCBQueue* queue){
         return;
     }
     queue->size = 0;
-    queue->LastProg = (PCB*)malloc(sizeof(PCB));
-    queue->firstProg = queue->LastProg;
+    queue->firstProg = NULL;
+    queue->LastProg = NULL;
 }
 
-
-
-void EnterQueue(PCBQueue* queue,PCB* pro){   //加入进程队列
-    queue->LastProg->next = (PCB*)malloc(sizeof(PCB));
-    queue->LastProg = queue->LastProg->next;
-    queue->LastProg->enter_time = pro->enter_time;
-//    将name复制给 LastProg
-    memcpy(queue->LastProg->name,pro->name,sizeof(pro->name));
-    queue->LastProg->priority = pro->priority;
-    queue->LastProg->running_time = pro->running_time;
-    queue->LastProg->copyRunning_time = pro->copyRunning_time;
-    queue->LastProg->start_time = pro->start_time;
+//加入进程队列：直接用PCB自带的next链接，不分配也不复制，一个PCB同一时间只能在一个队列里
+void EnterQueue(PCBQueue* queue,PCB* pro){
+    pro->next = NULL;
+    if(queue->LastProg == NULL)
+        queue->firstProg = pro;
+    else
+        queue->LastProg->next = pro;
+    queue->LastProg = pro;
     queue->size++;
 }
 PCB* poll(PCBQueue* queue){
-    PCB* temp = queue->firstProg->next;
-    if(temp == queue->LastProg){
-        queue->LastProg=queue->firstProg;
-        queue->size--;
-        return temp;
-    }
-    queue->firstProg->next = queue->firstProg->next->next;
+    PCB* temp = queue->firstProg;
+    queue->firstProg = temp->next;
+    if(queue->firstProg == NULL)
+        queue->LastProg = NULL;
+    temp->next = NULL;
     queue->size--;
     return temp;
 }
@@ -74,25 +68,56 @@ void inputPCB(PCB pro[],int num){
     }
 }
 
-//冒泡排序算法（每次找到最大的放在末尾）
+//按下标数组重排pro[start,start+len)，每个PCB只移动一次
+void permuteByIndex(PCB pro[],int start,int len,const int idx[]){
+    PCB* buf = (PCB*)malloc(len*sizeof(PCB));
+    for(int k=0;k<len;k++)
+        buf[k] = pro[start+idx[k]];
+    memcpy(pro+start,buf,len*sizeof(PCB));
+    free(buf);
+}
+
+//按到达时间做基数排序（稳定，O(n)），排序的是(到达时间,下标)对，最后再重排PCB
 void sortWithEnterTime(PCB pro[],int num){
-    for(int i=1;i<num;i++){
-        for(int j= 0;j<num-i;j++){
-            if(pro[j].enter_time>pro[j+1].enter_time){
-                PCB temp = pro[j];
-                pro[j] = pro[j+1];
-                pro[j+1] = temp;
-            }
+    if(num <= 1)
+        return;
+    unsigned int* key = (unsigned int*)malloc(num*sizeof(unsigned int));
+    unsigned int* key2 = (unsigned int*)malloc(num*sizeof(unsigned int));
+    int* idx = (int*)malloc(num*sizeof(int));
+    int* idx2 = (int*)malloc(num*sizeof(int));
+    for(int i=0;i<num;i++){
+        key[i] = (unsigned int)pro[i].enter_time ^ 0x80000000u;   //翻转符号位，负数也按大小排
+        idx[i] = i;
+    }
+    for(int shift=0;shift<32;shift+=8){    //每趟按8位分配，共4趟
+        int count[257] = {0};
+        for(int i=0;i<num;i++)
+            count[((key[i]>>shift)&255)+1]++;
+        if(count[((key[0]>>shift)&255)+1] == num)    //这8位全都相同，跳过这一趟
+            continue;
+        for(int b=0;b<256;b++)
+            count[b+1] += count[b];
+        for(int i=0;i<num;i++){
+            int pos = count[(key[i]>>shift)&255]++;
+            key2[pos] = key[i];
+            idx2[pos] = idx[i];
         }
+        unsigned int* tk = key; key = key2; key2 = tk;
+        int* ti = idx; idx = idx2; idx2 = ti;
     }
+    permuteByIndex(pro,0,num,idx);
+    free(key);
+    free(key2);
+    free(idx);
+    free(idx2);
 }
 
 void FCFS(PCB pro[],int num){
     printf("进程 到达时间  服务时间 开始时间 完成时间 周转时间 带权周转时间\n");
     sortWithEnterTime(pro,num);    //按照进入顺序排序
-    PCBQueue* queue = (PCBQueue*)malloc(sizeof(PCBQueue));
-    Queueinit(queue);
-    EnterQueue(queue,&pro[0]);
+    PCBQueue queue;
+    Queueinit(&queue);
+    EnterQueue(&queue,&pro[0]);
     int time = pro[0].enter_time;
     int pronum=1;    //记录当前的进程
     //平均周转时间
@@ -100,8 +125,8 @@ void FCFS(PCB pro[],int num){
 //    带权平均周转时间
     float sum_QT_time = 0 ;
 
-    while(queue->size>0){
-        PCB* curpro = poll(queue);   //从进程队列中取出进程
+    while(queue.size>0){
+        PCB* curpro = poll(&queue);   //从进程队列中取出进程
         if(time < curpro->enter_time)
             time =  curpro->enter_time;
         //完成时间
@@ -112,17 +137,15 @@ void FCFS(PCB pro[],int num){
         // 带权周转时间（（作业完成的时间-作业到达的时间）/ 作业运行时间）
         float QT_time = T_time / (curpro->running_time+0.0) ;
         sum_QT_time += QT_time;
-        for(int tt = time;tt<=done_time && pronum<num;tt++){    //模拟进程的执行过程
-            if(tt >= pro[pronum].enter_time){
-                EnterQueue(queue,&pro[pronum]);
-                pronum++;
-            }
+        while(pronum<num && pro[pronum].enter_time<=done_time){    //运行期间到达的进程依次入队，不再逐个时刻扫描
+            EnterQueue(&queue,&pro[pronum]);
+            pronum++;
         }
         printf("%s\t%d \t%d\t%d\t %d\t  %d\t\t%.2f\n",curpro->name,curpro->enter_time,curpro->running_time,time,done_time
                ,T_time,QT_time);
         time += curpro->running_time;
-        if(queue->size==0 && pronum < num){   //防止出现前一个进程执行完到下一个进程到达之间无进程进入
-            EnterQueue(queue,&pro[pronum]);
+        if(queue.size==0 && pronum < num){   //防止出现前一个进程执行完到下一个进程到达之间无进程进入
+            EnterQueue(&queue,&pro[pronum]);
             pronum++;
         }
     }
@@ -20,45 +20,6 @@ typedef struct PCB{
     struct PCB* next;
 } PCB;
 
-typedef struct PCBQueue{
-    PCB* firstProg;
-    PCB* LastProg;
-    int size;
-} PCBQueue;
-
-void Queueinit(PCBQueue* queue){
-    if(queue==NULL){
-        return;
-    }
-    queue->size = 0;
-    queue->LastProg = (PCB*)malloc(sizeof(PCB));
-    queue->firstProg = queue->LastProg;
-}
-
-void EnterQueue(PCBQueue* queue,PCB* pro){   //加入进程队列
-    queue->LastProg->next = (PCB*)malloc(sizeof(PCB));
-    queue->LastProg = queue->LastProg->next;
-    queue->LastProg->enter_time = pro->enter_time;
-//    将name复制给 LastProg
-    memcpy(queue->LastProg->name,pro->name,sizeof(pro->name));
-    queue->LastProg->priority = pro->priority;
-    queue->LastProg->running_time = pro->running_time;
-    queue->LastProg->copyRunning_time = pro->copyRunning_time;
-    queue->LastProg->start_time = pro->start_time;
-    queue->size++;
-}
-PCB* poll(PCBQueue* queue){
-    PCB* temp = queue->firstProg->next;
-    if(temp == queue->LastProg){
-        queue->LastProg=queue->firstProg;
-        queue->size--;
-        return temp;
-    }
-    queue->firstProg->next = queue->firstProg->next->next;
-    queue->size--;
-    return temp;
-}
-
 void inputPCB(PCB pro[],int num){
     for(int i=0;i<num;i++){
         PCB prog ;
@@ -72,76 +33,98 @@ void inputPCB(PCB pro[],int num){
     }
 }
 
-//冒泡排序算法（每次找到最大的放在末尾）
-void sortWithEnterTime(PCB pro[],int num){
-    for(int i=1;i<num;i++){
-        for(int j= 0;j<num-i;j++){
-            if(pro[j].enter_time>pro[j+1].enter_time){
-                PCB temp = pro[j];
-                pro[j] = pro[j+1];
-                pro[j+1] = temp;
-            }
-        }
-    }
+//按下标数组重排pro[start,start+len)，每个PCB只移动一次
+void permuteByIndex(PCB pro[],int start,int len,const int idx[]){
+    PCB* buf = (PCB*)malloc(len*sizeof(PCB));
+    for(int k=0;k<len;k++)
+        buf[k] = pro[start+idx[k]];
+    memcpy(pro+start,buf,len*sizeof(PCB));
+    free(buf);
 }
 
-//按照响应比排序（倒序）
-void sortWithResponse(PCB pro[],int start,int end){
-    int len = end - start;
-    if(len == 1)
+//按到达时间做基数排序（稳定，O(n)），排序的是(到达时间,下标)对，最后再重排PCB
+void sortWithEnterTime(PCB pro[],int num){
+    if(num <= 1)
         return;
-    for(int i=1;i<len;i++){
-        for(int j= start;j<end-i;j++){
-            //计算响应比
-            float m = (pro[j].start_time-pro[j].enter_time+pro[j].running_time)/(pro[j].running_time+0.0);
-            float n = (pro[j+1].start_time-pro[j+1].enter_time+pro[j+1].running_time)/(pro[j+1].running_time+0.0);
-            if(m < n){
-                PCB temp = pro[j];
-                pro[j] = pro[j+1];
-                pro[j+1] = temp;
-            }
+    unsigned int* key = (unsigned int*)malloc(num*sizeof(unsigned int));
+    unsigned int* key2 = (unsigned int*)malloc(num*sizeof(unsigned int));
+    int* idx = (int*)malloc(num*sizeof(int));
+    int* idx2 = (int*)malloc(num*sizeof(int));
+    for(int i=0;i<num;i++){
+        key[i] = (unsigned int)pro[i].enter_time ^ 0x80000000u;   //翻转符号位，负数也按大小排
+        idx[i] = i;
+    }
+    for(int shift=0;shift<32;shift+=8){    //每趟按8位分配，共4趟
+        int count[257] = {0};
+        for(int i=0;i<num;i++)
+            count[((key[i]>>shift)&255)+1]++;
+        if(count[((key[0]>>shift)&255)+1] == num)    //这8位全都相同，跳过这一趟
+            continue;
+        for(int b=0;b<256;b++)
+            count[b+1] += count[b];
+        for(int i=0;i<num;i++){
+            int pos = count[(key[i]>>shift)&255]++;
+            key2[pos] = key[i];
+            idx2[pos] = idx[i];
         }
+        unsigned int* tk = key; key = key2; key2 = tk;
+        int* ti = idx; idx = idx2; idx2 = ti;
     }
+    permuteByIndex(pro,0,num,idx);
+    free(key);
+    free(key2);
+    free(idx);
+    free(idx2);
 }
 
+//计算响应比
+float responseRatio(const PCB* p){
+    return (p->start_time-p->enter_time+p->running_time)/(p->running_time+0.0);
+}
+int higherResponseFirst(const PCB* x,const PCB* y){
+    return responseRatio(x) > responseRatio(y);
+}
+
+/*
+ * 高响应比优先：响应比随等待时间变化，每次调度都要重新比较全部就绪进程，
+ * 堆帮不上忙，就绪进程放在无序数组里，调度时线性扫描找响应比最高的，O(n)。
+ * 响应比相同时pro[]中靠前（先到达）的先运行。
+ */
 void HRRN(PCB pro[],int num) {
     printf("进程 到达时间  服务时间 开始时间 完成时间 周转时间 带权周转时间\n");
     sortWithEnterTime(pro,num);
-    PCBQueue* queue = (PCBQueue*)malloc(sizeof(PCBQueue));;
-    Queueinit(queue);
-    EnterQueue(queue,&pro[0]);
-    int time = pro[0].enter_time;
-    int pronum=1;    //记录当前的进程
+    PCB** ready = (PCB**)malloc((num > 0 ? num : 1)*sizeof(PCB*));
+    int size = 0;
+    int time = num > 0 ? pro[0].enter_time : 0;
+    int pronum = 0;    //下一个到达的进程
     float sum_T_time = 0,sum_QT_time = 0;
-    while(queue->size>0){
-        PCB* curpro = poll(queue);   //从进程队列中取出进程
-        if(time <  curpro->enter_time)
-            time =  curpro->enter_time;
+    while(pronum < num || size > 0){
+        if(size == 0 && time < pro[pronum].enter_time)    //CPU空闲，直接到下一个进程到达
+            time = pro[pronum].enter_time;
+        while(pronum < num && pro[pronum].enter_time <= time)
+            ready[size++] = &pro[pronum++];
+        int best = 0;
+        for(int k=0;k<size;k++){
+            ready[k]->start_time = time;
+            if(k == 0)
+                continue;
+            if(higherResponseFirst(ready[k],ready[best])
+               || (!higherResponseFirst(ready[best],ready[k]) && ready[k] < ready[best]))
+                best = k;
+        }
+        PCB* curpro = ready[best];
+        ready[best] = ready[--size];
         int done_time = time+curpro->running_time;
         int T_time = done_time - curpro->enter_time;
         float QT_time = T_time / (curpro->running_time+0.0) ;
         sum_T_time += T_time;
         sum_QT_time += QT_time;
-        int pre = pronum;
-        for(int tt = time;tt<=done_time&&pronum<num;tt++){    //模拟进程的执行过程
-            if(tt>=pro[pronum].enter_time){ // 统计从此任务开始到结束之间有几个进程到达
-                pronum++;
-            }
-        }
-        sortWithResponse(pro,pre,pronum);//将到达的进程按照响应时间排序
-        for(int i=pre;i<pronum;i++){    //将进程链入队列
-            EnterQueue(queue,&pro[i]);
-        }
-        pre = pronum;
         printf("%s\t%d \t%d\t%d\t %d\t  %d\t\t%.2f\n",curpro->name,curpro->enter_time,curpro->running_time,time,done_time
                ,T_time,QT_time);
-        time +=  curpro->running_time;
-        if(queue->size==0&&pronum<num){   //防止出现前一个进程执行完到下一个进程到达之间无进程进入
-            EnterQueue(queue,&pro[pronum]);
-            pronum++;
-        }
+        time = done_time;
     }
-    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\n",sum_T_time/(num+0.0),sum_QT_time/num);
+    printf("平均周转时间为%.2f\t平均带权周转时间为%.2f\n",sum_T_time/(num+0.0),sum_QT_time/(num+0.0));
+    free(ready);
 }
 
 void menu(){
@@ -150,7 +133,6 @@ void menu(){
     scanf("%d",&proNum);
     PCB pro[proNum];
     inputPCB(pro,proNum);
-    int choice;
     while(1){
         HRRN(pro,proNum);
         return;
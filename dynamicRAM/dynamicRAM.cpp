@@ -1,18 +1,45 @@
 #include <iostream>
 #include<stdlib.h>
+#include<string.h>
 #include<time.h>
+#include <errno.h>
+#include <limits.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <sys/mman.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 using namespace std;
 
 #define FREE 0
 #define BUSY 1
-#define MAX_length 512
-#define SYSTEM_SIZE 128
+#define KB (1LL << 10)
+#define MB (1LL << 20)
+#define GB (1LL << 30)
+#define TB (1LL << 40)
+
+typedef long long memsize;//地址与大小统一用64位，单位为字节
+
+struct MemConfig {//模拟的内存配置
+	memsize arena;//内存总大小
+	memsize reserved;//系统保留区大小，从地址0开始
+	memsize align;//分配粒度（对齐），分区大小与地址都是它的整数倍
+	memsize granule;//位图模式下每一位代表的大小
+};
+
+MemConfig cfg = { 512 * MB, 128 * MB, 1, 4 * KB };
 
 typedef struct freeArea {//首先定义空闲区分表结构
 	int flag;
-	int size;
+	memsize size;
 	int ID;
-	int address;
+	memsize address;//相对保留区之后的偏移
 }Elemtype;
 
 typedef struct Free_Node {
@@ -25,34 +52,125 @@ FNodeList block_first;
 FNodeList block_last;
 
 void init();//初始化
+void init_list(FNodeList* first, FNodeList* last, memsize address, memsize size);//初始化一条分区链
 int alloc(int tag);//内存分配
 int free(int ID);//内存回收
-int first_fit(int ID, int size);//首次适应算法
-int best_fit(int ID, int size);//最佳适应算法
+int release(int ID);//内存回收（不输出）
+Free_Node* release_node(Free_Node* p);//回收一个分区并与相邻空闲区合并，返回合并后的空闲区
+int first_fit(int ID, memsize size);//首次适应算法
+int best_fit(int ID, memsize size);//最佳适应算法
+Free_Node* first_fit_in(FNodeList head, int ID, memsize size);//在指定链上做首次适应
+Free_Node* best_fit_in(FNodeList head, int ID, memsize size);//在指定链上做最佳适应
+int bitmap_fit(int ID, memsize size);//位图分配
+int bm_release(int ID);//位图回收
+void show_bitmap();//查看位图分配
 void show();//查看分配
-void init();//初始化
+memsize parse_size(const char* str);//解析带单位的大小
+string format_size(memsize size);//按最大的整除单位输出大小
 void menu();
 
+memsize align_up(memsize size, memsize align) {
+	return (size + align - 1) / align * align;
+}
+
+memsize parse_size(const char* str) {//如 4096、64K、128M、2G、4T，非法返回-1
+	char* end;
+	errno = 0;
+	long long v = strtoll(str, &end, 10);
+	if (end == str || v < 0 || errno == ERANGE) return -1;
+	memsize unit = 1;
+	switch (*end) {
+	case 'K': case 'k': unit = KB; end++; break;
+	case 'M': case 'm': unit = MB; end++; break;
+	case 'G': case 'g': unit = GB; end++; break;
+	case 'T': case 't': unit = TB; end++; break;
+	}
+	if (v > LLONG_MAX / unit) return -1;//乘上单位会溢出
+	v *= unit;
+	if (*end == 'B' || *end == 'b') end++;
+	return *end ? -1 : v;
+}
+
+string format_size(memsize size) {
+	const char* unit[] = { "TB", "GB", "MB", "KB" };
+	const memsize mul[] = { TB, GB, MB, KB };
+	for (int i = 0; i < 4; i++)
+		if (size >= mul[i] && size % mul[i] == 0)
+			return to_string(size / mul[i]) + unit[i];
+	return to_string(size) + "B";
+}
+
+#ifdef DYNRAM_LIB
+//库模式下不能再调用malloc，分区结点从单独映射的结点池中分配
+#define NODE_CHUNK (1 * MB)
+static Free_Node* node_pool;//空闲结点链，用next串起来
+
+static Free_Node* new_node() {
+	if (node_pool == NULL) {
+		void* chunk = mmap(NULL, NODE_CHUNK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (chunk == MAP_FAILED) return NULL;
+		Free_Node* nodes = (Free_Node*)chunk;
+		size_t cnt = NODE_CHUNK / sizeof(Free_Node);
+		for (size_t i = 0; i < cnt; i++) {
+			nodes[i].next = node_pool;
+			node_pool = &nodes[i];
+		}
+	}
+	Free_Node* p = node_pool;
+	node_pool = p->next;
+	return p;
+}
+
+static void delete_node(Free_Node* p) {
+	p->next = node_pool;
+	node_pool = p;
+}
+#else
+static Free_Node* new_node() {
+	return (Free_Node*)malloc(sizeof(Free_Node));
+}
+
+static void delete_node(Free_Node* p) {
+	free((void*)p);
+}
+#endif
+
+void init_list(FNodeList* first, FNodeList* last, memsize address, memsize size) {
+	*first = new_node();
+	*last = new_node();
+	(*first)->front = NULL;
+	(*first)->next = *last;
+	(*first)->date.flag = BUSY;//头结点视为已分配，回收时不会与它合并
+	(*first)->date.ID = FREE;
+	(*first)->date.size = 0;
+	(*first)->date.address = address;
+	(*last)->front = *first;
+	(*last)->next = NULL;
+	(*last)->date.address = address;
+	(*last)->date.flag = FREE;
+	(*last)->date.ID = FREE;
+	(*last)->date.size = size;
+}
+
+memsize user_size() {//保留区之外可分配的大小
+	return (cfg.arena - cfg.reserved) / cfg.align * cfg.align;
+}
+
 void init() {//初始化
-	block_first = new Free_Node;
-	block_last = new Free_Node;
-	block_first->front = NULL;
-	block_first->next = block_last;
-	block_last->front = block_first;
-	block_last->next = NULL;
-	block_last->date.address = 0;
-	block_last->date.flag = FREE;
-	block_last->date.ID = FREE;
-	block_last->date.size = MAX_length - SYSTEM_SIZE;;
+	init_list(&block_first, &block_last, 0, user_size());
 }
 
+#ifndef DYNRAM_LIB
 //实现内存分配
 int alloc(int tag) {
-	int ID, size1;
+	int ID;
+	memsize size1;
+	string str;
 	cout << "请输入作业号：";
 	cin >> ID;
-	cout << "请输入所需内存大小：";
-	cin >> size1;
+	cout << "请输入所需内存大小（可带K/M/G/T）：";
+	cin >> str;
+	size1 = parse_size(str.c_str());
 	if (ID <= 0 || size1 <= 0) {
 		cout << "输入错误！请输入正确的ID和请求大小：" << endl;
 		return 0;
@@ -63,6 +181,11 @@ int alloc(int tag) {
 		else cout << "分配失败！" << endl;
 		return 1;
 	}
+	else if (tag == 6) {//采用位图分配
+		if (bitmap_fit(ID, size1))  cout << "分配成功！" << endl;
+		else cout << "分配失败！" << endl;
+		return 1;
+	}
 	else {
 		if (best_fit(ID, size1)) cout << "分配成功！" << endl;
 		else cout << "分配失败！" << endl;
@@ -71,113 +194,103 @@ int alloc(int tag) {
 
 }
 
-int first_fit(int ID, int size) {//首次适应算法
-	FNodeList temp = (FNodeList)malloc(sizeof(Free_Node));
-	Free_Node* p = block_first->next;
+#endif
+
+int first_fit(int ID, memsize size) {//首次适应算法
+	return first_fit_in(block_first, ID, size) != NULL;
+}
+
+int best_fit(int ID, memsize size) {//最佳适应算法
+	return best_fit_in(block_first, ID, size) != NULL;
+}
+
+//在空闲区p的前部切出size大小的分区，返回新分区
+static Free_Node* split_front(Free_Node* p, int ID, memsize size) {
+	if (p->date.size == size) {//请求大小刚好满足
+		p->date.flag = BUSY;
+		p->date.ID = ID;
+		return p;
+	}
+	FNodeList temp = new_node();
+	if (temp == NULL) return NULL;
 	temp->date.ID = ID;
 	temp->date.size = size;
 	temp->date.flag = BUSY;
+	temp->next = p;
+	temp->front = p->front;
+	temp->date.address = p->date.address;
+	p->front->next = temp;
+	p->front = temp;
+	p->date.address = temp->date.address + temp->date.size;
+	p->date.size -= size;
+	return temp;
+}
+
+Free_Node* first_fit_in(FNodeList head, int ID, memsize size) {
+	size = align_up(size, cfg.align);
+	Free_Node* p = head->next;
 	while (p) {
-		if (p->date.flag == FREE && p->date.size == size) {//请求大小刚好满足
-			p->date.flag = BUSY;
-			p->date.ID = ID;
-			return 1;
-			break;
-		}
-		if (p->date.flag == FREE && p->date.size > size) {//说明还有其他的空闲区间
-			temp->next = p;
-			temp->front = p->front;
-			temp->date.address = p->date.address;
-			p->front->next = temp;
-			p->front = temp;
-			p->date.address = temp->date.address + temp->date.size;
-			p->date.size -= size;
-			return 1;
-			break;
-		}
+		if (p->date.flag == FREE && p->date.size >= size)
+			return split_front(p, ID, size);
 		p = p->next;
 	}
-	return 0;
+	return NULL;
 }
 
-int best_fit(int ID, int size) {//最佳适应算法
-	int surplus;//记录可用内存与需求内存的差值
-	FNodeList temp = (FNodeList)malloc(sizeof(Free_Node));
-	Free_Node* p = block_first->next;
-	temp->date.ID = ID;
-	temp->date.size = size;
-	temp->date.flag = BUSY;
+Free_Node* best_fit_in(FNodeList head, int ID, memsize size) {
+	size = align_up(size, cfg.align);
+	Free_Node* p = head->next;
 	Free_Node* q = NULL;//记录最佳位置
-	while (p) {//遍历链表，找到第一个可用的空闲区间将他给q 
+	while (p) {
 		if (p->date.flag == FREE && p->date.size >= size) {
-			q = p;
-			surplus = p->date.size - size;
-			break;
+			if (p->date.size == size)//刚好满足，不可能更好
+				return split_front(p, ID, size);
+			if (q == NULL || q->date.size > p->date.size)
+				q = p;
 		}
 		p = p->next;
 	}
-	while (p) {//继续遍历，找到更加合适的位置 
-		if (p->date.flag == FREE && p->date.size == size) {
-			p->date.flag = BUSY;
-			p->date.ID = ID;
-			return 1;
-			break;
-		}
-		if (p->date.flag == FREE && p->date.size > size) {
-			if (surplus > p->date.size - size) {
-				surplus = p->date.size - size;
-				q = p;
-			}
+	if (q == NULL)  return NULL;
+	return split_front(q, ID, size);//找到了最佳位置
+}
 
-		}
-		p = p->next;
+Free_Node* release_node(Free_Node* p) {//回收分区p，判断p与前后区域关系
+	p->date.flag = FREE;
+	p->date.ID = FREE;
+	Free_Node* q = p->next;
+	if (q && q->date.flag == FREE) {//与后一个空闲区合并
+		p->date.size += q->date.size;
+		p->next = q->next;
+		if (q->next) q->next->front = p;
+		delete_node(q);
 	}
-	if (q == NULL)  return 0;
-	else {//找到了最佳位置
-		temp->next = q;
-		temp->front = q->front;
-		temp->date.address = q->date.address;
-		q->front->next = temp;
-		q->front = temp;
-		q->date.size = surplus;
-		q->date.address += size;
-		return 1;
+	q = p->front;
+	if (q->date.flag == FREE) {//与前一个空闲区合并
+		q->date.size += p->date.size;
+		q->next = p->next;
+		if (p->next) p->next->front = q;
+		delete_node(p);
+		return q;
 	}
+	return p;
 }
 
-int free(int ID) {//主存回收
+#ifndef DYNRAM_LIB
+int release(int ID) {//按作业号回收，不输出
+	if (ID == FREE) return 0;
 	Free_Node* p = block_first->next;
 	while (p) {
-		if (p->date.ID == ID) {//找到要回收的ID区域 
-			p->date.flag = FREE;
-			p->date.ID = FREE;
-			//判断P与前后区域关系
-			if (p->front->date.flag == FREE && p->next->date.flag != FREE) {
-				p->front->date.size += p->date.size;
-				p->front->next = p->next;
-				p->next->front = p->front;
-			}
-			if (p->front->date.flag != FREE && p->next->date.flag == FREE) {
-				p->date.size += p->next->date.size;
-				if (p->next->next) {
-					p->next->next->front = p;
-					p->next = p->next->next;
-				}
-				else p->next = p->next->next;
-			}
-			if (p->front->date.flag == FREE && p->next->date.flag == FREE) {
-				p->front->date.size += p->date.size + p->next->date.size;
-				if (p->next->next) {
-					p->next->next->front = p->front;
-					p->front->next = p->next->next;
-				}
-				else p->front->next = p->next->next;
-			}
-			if (p->front->date.flag != FREE && p->next->date.flag != FREE);
-			break;
+		if (p->date.flag == BUSY && p->date.ID == ID) {//找到要回收的ID区域
+			release_node(p);
+			return 1;
 		}
 		p = p->next;
 	}
+	return 0;
+}
+
+int free(int ID) {//主存回收
+	release(ID);
 	cout << "回收成功！" << endl;
 	return 1;
 }
@@ -187,7 +300,7 @@ void show() {
 	Free_Node* p = block_first->next;
     cout << "分区号：SYSTEM" << endl;
     cout << "起始地址：" << 0 << endl;
-	cout << "内存大小：" << SYSTEM_SIZE << endl;
+	cout << "内存大小：" << format_size(cfg.reserved) << endl;
     cout << "分区状态：已分配" << endl;
 	cout << "**************************" << endl;
 	while (p) {
@@ -195,8 +308,8 @@ void show() {
 		if (p->date.ID == FREE)
 			cout << "FREE" << endl;
 		else cout << p->date.ID << endl;
-		cout << "起始地址：" << p->date.address + 128 << "MB" << endl;
-		cout << "内存大小：" << p->date.size  << "MB" << endl;
+		cout << "起始地址：" << format_size(p->date.address + cfg.reserved) << endl;
+		cout << "内存大小：" << format_size(p->date.size) << endl;
 		cout << "分区状态：";
 		if (p->date.flag == FREE)
 			cout << "空闲" << endl;
@@ -206,13 +319,518 @@ void show() {
 		p = p->next;
 	}
 }
+#endif
+
+/*
+ * 位图分配模式
+ * 内存按 cfg.granule 划分为固定粒度，每个粒度占位图中一位（1为已分配）。
+ * 查找连续空闲粒度时一次处理一个64位字：全空闲/全占用的字整体跳过，
+ * 部分占用的字用 ctz 求出空闲段和占用段的长度；编译时打开 AVX2
+ * 则一次比较4个字以跳过整段已分配区。
+ */
+#define BM_FULL (~(uint64_t)0)
+
+uint64_t* bm_map;//位图
+memsize bm_bits;//粒度总数
+memsize bm_words;//位图字数
+memsize bm_hint;//第一个可能有空闲位的字
+unordered_map<int, pair<memsize, memsize> > bm_jobs;//作业号 -> (起始粒度, 粒度数)
+
+void bm_init(memsize size) {//初始化位图，size为可分配的总大小
+	bm_bits = size / cfg.granule;
+	bm_words = (bm_bits + 63) / 64;
+#ifdef DYNRAM_LIB
+	bm_map = (uint64_t*)mmap(NULL, bm_words * sizeof(uint64_t), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+#else
+	delete[] bm_map;
+	bm_map = new uint64_t[bm_words]();
+	bm_jobs.clear();
+#endif
+	if (bm_bits % 64)//超出范围的尾部位视为已分配
+		bm_map[bm_words - 1] = BM_FULL << (bm_bits % 64);
+	bm_hint = 0;
+}
+
+static void bm_set(memsize start, memsize n, bool used) {//将[start, start+n)置为已分配/空闲
+	memsize w = start >> 6;
+	int b = start & 63;
+	while (n > 0) {
+		int k = n < 64 - b ? (int)n : 64 - b;
+		uint64_t mask = (k == 64 ? BM_FULL : (((uint64_t)1 << k) - 1)) << b;
+		if (used) bm_map[w] |= mask;
+		else bm_map[w] &= ~mask;
+		n -= k;
+		w++;
+		b = 0;
+	}
+}
+
+memsize bm_find(memsize n) {//查找n个连续空闲粒度，返回起始粒度，找不到返回-1
+	memsize run = 0, runStart = 0;
+	for (memsize w = bm_hint; w < bm_words; w++) {
+#ifdef __AVX2__
+		if (run == 0) {//跳过整段已分配的字
+			const __m256i full = _mm256_set1_epi64x(-1);
+			while (w + 4 <= bm_words &&
+				_mm256_testc_si256(_mm256_loadu_si256((const __m256i*)(bm_map + w)), full))
+				w += 4;
+			if (w == bm_words) break;
+		}
+#endif
+		uint64_t used = bm_map[w];
+		if (used == 0) {//整个字空闲
+			if (run == 0) runStart = w * 64;
+			run += 64;
+			if (run >= n) return runStart;
+			continue;
+		}
+		if (used == BM_FULL) {//整个字已分配
+			run = 0;
+			continue;
+		}
+		int bit = 0;
+		while (bit < 64) {
+			uint64_t rest = used >> bit;
+			int freeLen = rest ? __builtin_ctzll(rest) : 64 - bit;//从bit开始的空闲位数
+			if (freeLen > 0) {
+				if (run == 0) runStart = w * 64 + bit;
+				run += freeLen;
+				if (run >= n) return runStart;
+				bit += freeLen;
+				if (bit >= 64) break;
+			}
+			bit += __builtin_ctzll(~(used >> bit));//跳过已分配位
+			run = 0;
+		}
+	}
+	return -1;
+}
+
+memsize bm_free_count() {//空闲粒度数
+	memsize cnt = 0;
+	for (memsize w = 0; w < bm_words; w++)
+		cnt += __builtin_popcountll(~bm_map[w]);
+	return cnt;
+}
+
+memsize bm_alloc_run(memsize n) {//分配n个连续粒度
+	memsize start = bm_find(n);
+	if (start < 0) return -1;
+	bm_set(start, n, true);
+	while (bm_hint < bm_words && bm_map[bm_hint] == BM_FULL) bm_hint++;
+	return start;
+}
+
+void bm_free_run(memsize start, memsize n) {//回收[start, start+n)
+	bm_set(start, n, false);
+	if (start / 64 < bm_hint) bm_hint = start / 64;
+}
+
+#ifndef DYNRAM_LIB
+int bitmap_fit(int ID, memsize size) {//位图分配
+	if (size <= 0 || bm_jobs.count(ID)) return 0;
+	memsize n = (size + cfg.granule - 1) / cfg.granule;
+	memsize start = bm_alloc_run(n);
+	if (start < 0) return 0;
+	bm_jobs[ID] = make_pair(start, n);
+	return 1;
+}
+
+int bm_release(int ID) {//位图回收
+	auto it = bm_jobs.find(ID);
+	if (it == bm_jobs.end()) return 0;
+	bm_free_run(it->second.first, it->second.second);
+	bm_jobs.erase(it);
+	return 1;
+}
+
+void show_bitmap() {
+	cout << "*******位图分配情况*******" << endl;
+	vector<pair<memsize, int> > jobs;
+	for (auto& j : bm_jobs) jobs.push_back(make_pair(j.second.first, j.first));
+	sort(jobs.begin(), jobs.end());
+	for (auto& j : jobs) {
+		cout << "分区号：" << j.second << endl;
+		cout << "起始地址：" << format_size(j.first * cfg.granule + cfg.reserved) << endl;
+		cout << "内存大小：" << format_size(bm_jobs[j.second].second * cfg.granule) << endl;
+		cout << "**************************" << endl;
+	}
+	cout << "空闲粒度：" << bm_free_count() << "/" << bm_bits << "（每粒度" << format_size(cfg.granule) << "）" << endl;
+}
+
+/*
+ * 并发分配模式
+ * 全局空闲区按地址划分为 MT_SHARDS 个分片，每个分片一条分区链、一把锁；
+ * 每个线程另有一个私有缓存，保存最近释放的块（仍在链上标记为已分配），
+ * 同样大小的请求直接从缓存取，不加锁。缓存未命中时一次加锁批量切出
+ * MT_BATCH 块；缓存满时按分片分组、每个分片加一次锁批量归还。
+ */
+#define MT_SHARDS 8
+#define MT_CACHE_MAX 32
+#define MT_BATCH 8
+#define MT_ID (-1)//并发模式下的分区不按作业号回收
+
+struct Shard {
+	FNodeList first;
+	FNodeList last;
+	mutex lock;
+};
+
+Shard shards[MT_SHARDS];
+memsize shard_size;//每个分片的大小
+
+void mt_flush(int keep);
+
+struct ThreadCache {//线程私有缓存
+	Free_Node* blk[MT_CACHE_MAX];
+	int count = 0;
+	~ThreadCache() { mt_flush(0); }//线程退出时归还全部缓存块
+};
+
+thread_local ThreadCache tcache;
+
+static int mt_home() {//当前线程的主分片
+	return (int)(hash<thread::id>()(this_thread::get_id()) % MT_SHARDS);
+}
+
+static void free_list(Free_Node* p) {//释放整条分区链
+	while (p) {
+		Free_Node* q = p->next;
+		delete_node(p);
+		p = q;
+	}
+}
+
+void mt_init(memsize total) {//初始化（或重置）各分片，total为并发模式下可分配的总大小
+	shard_size = total / MT_SHARDS / cfg.align * cfg.align;
+	for (int i = 0; i < MT_SHARDS; i++) {
+		if (shards[i].first) free_list(shards[i].first);
+		init_list(&shards[i].first, &shards[i].last, i * shard_size, shard_size);
+	}
+}
+
+Free_Node* mt_alloc(memsize size) {//并发模式的分配
+	if (size <= 0) return NULL;
+	size = align_up(size, cfg.align);
+	if (size > shard_size) return NULL;//分区不跨分片，超过一个分片的请求无论空闲多少都不能满足
+	ThreadCache& tc = tcache;
+	for (int i = tc.count - 1; i >= 0; i--) {//先查线程缓存
+		if (tc.blk[i]->date.size == size) {
+			Free_Node* p = tc.blk[i];
+			tc.blk[i] = tc.blk[--tc.count];
+			return p;
+		}
+	}
+	int home = mt_home();
+	for (int k = 0; k < MT_SHARDS; k++) {
+		Shard& sh = shards[(home + k) % MT_SHARDS];
+		lock_guard<mutex> guard(sh.lock);
+		Free_Node* p = first_fit_in(sh.first, MT_ID, size);
+		if (p == NULL) continue;
+		//批量填充：同样大小的块多切几块放进缓存，最多填到缓存的一半
+		for (int i = 1; i < MT_BATCH && tc.count < MT_CACHE_MAX / 2; i++) {
+			Free_Node* q = first_fit_in(sh.first, MT_ID, size);
+			if (q == NULL) break;
+			tc.blk[tc.count++] = q;
+		}
+		return p;
+	}
+	if (tc.count > 0) {//各分片都不够，先把缓存全部归还再试一次
+		mt_flush(0);
+		return mt_alloc(size);
+	}
+	return NULL;
+}
+
+void mt_flush(int keep) {//把缓存归还到只剩keep块，同一分片的块只加一次锁
+	ThreadCache& tc = tcache;
+	if (tc.count <= keep) return;
+	//先算好每块所在的分片：release_node会合并并释放相邻结点，归还之后不能再读缓存里的块
+	int shard_of[MT_CACHE_MAX];
+	bool used[MT_SHARDS] = { false };
+	for (int i = keep; i < tc.count; i++) {
+		shard_of[i] = (int)(tc.blk[i]->date.address / shard_size);
+		used[shard_of[i]] = true;
+	}
+	for (int s = 0; s < MT_SHARDS; s++) {
+		if (!used[s]) continue;
+		lock_guard<mutex> guard(shards[s].lock);
+		for (int i = keep; i < tc.count; i++)
+			if (shard_of[i] == s)
+				release_node(tc.blk[i]);
+	}
+	tc.count = keep;
+}
+
+void mt_free(Free_Node* p) {//并发模式的回收：先放进线程缓存
+	ThreadCache& tc = tcache;
+	if (tc.count == MT_CACHE_MAX)
+		mt_flush(MT_CACHE_MAX - MT_BATCH);
+	tc.blk[tc.count++] = p;
+}
+
+void mtBench(int maxThreads) {//并发模式的扩展性测试：1到maxThreads个线程
+	const int OPS = 200000;//每个线程的操作次数
+	const int LIVE = 64;//每个线程最多同时持有的块数
+	double base = 0;
+	mt_init(user_size());
+	if (shard_size < 32 * cfg.align) {//测试请求最大32字节，按粒度对齐
+		cout << "可分配空间太小，每个分片至少要" << format_size(32 * cfg.align) << endl;
+		return;
+	}
+	cout << "可分配" << format_size(user_size()) << "，" << MT_SHARDS << "个分片，每片" << format_size(shard_size)
+		<< "，单次请求不能超过一个分片" << endl;
+	cout << "线程数\t总操作数\t耗时(ms)\t吞吐(ops/s)\t加速比" << endl;
+	for (int t = 1; t <= maxThreads; t++) {
+		mt_init(user_size());
+		auto start = chrono::steady_clock::now();
+		vector<thread> workers;
+		for (int w = 0; w < t; w++) {
+			workers.emplace_back([w]() {
+				unsigned seed = 2463534242u + w * 7919u;
+				Free_Node* live[LIVE];
+				int n = 0;
+				for (int i = 0; i < OPS; i++) {
+					seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+					if (n < LIVE && (n == 0 || seed % 2)) {
+						Free_Node* p = mt_alloc(1 << (seed >> 8) % 6);
+						if (p) live[n++] = p;
+					}
+					else {
+						int k = (seed >> 8) % n;
+						mt_free(live[k]);
+						live[k] = live[--n];
+					}
+				}
+				while (n > 0) mt_free(live[--n]);
+				mt_flush(0);
+			});
+		}
+		for (auto& th : workers) th.join();
+		double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		double ops = (double)OPS * t / (ms / 1000);
+		if (t == 1) base = ops;
+		cout << t << "\t" << OPS * t << "\t\t" << ms << "\t\t" << (long long)ops << "\t" << ops / base << endl;
+	}
+}
+
+/*
+ * 分配策略基准测试
+ * 每种负载先按固定种子生成操作序列，各策略回放同一序列，统计
+ * 吞吐、单次操作的p99延迟、峰值占用（用到的最高地址）、回放结束时的
+ * 外部碎片率以及分配失败次数。碎片率只看峰值占用以下的空闲区
+ * （1 - 其中最大空闲块/其中空闲总量），从没用到过的尾部总是最大的空闲块，算进去各策略都接近0。
+ * 吞吐用一遍不计时的回放测；p99另回放一遍逐个计时，并减去两次取时钟本身的开销。
+ */
+struct BenchBlock {//一次分配得到的块
+	Free_Node* node;//首次/最佳适应
+	memsize start, n;//位图
+	bool live;
+};
+
+struct BenchOp {
+	bool alloc;
+	int slot;
+	memsize size;
+};
+
+struct Strategy {
+	const char* name;
+	bool (*take)(memsize size, BenchBlock* b);
+	void (*give)(BenchBlock* b);
+};
+
+memsize bench_top;//当前负载中用到的最高地址
+
+static void bench_reset() {
+	if (block_first) free_list(block_first);
+	init();
+	bm_init(user_size());
+	bench_top = 0;
+}
+
+static bool take_list(Free_Node* p, BenchBlock* b) {
+	if (p == NULL) return false;
+	b->node = p;
+	bench_top = max(bench_top, p->date.address + p->date.size);
+	return true;
+}
+static bool take_ff(memsize size, BenchBlock* b) { return take_list(first_fit_in(block_first, 1, size), b); }
+static bool take_bf(memsize size, BenchBlock* b) { return take_list(best_fit_in(block_first, 1, size), b); }
+static void give_list(BenchBlock* b) { release_node(b->node); }
+
+static bool take_bm(memsize size, BenchBlock* b) {
+	b->n = (size + cfg.granule - 1) / cfg.granule;
+	b->start = bm_alloc_run(b->n);
+	if (b->start < 0) return false;
+	bench_top = max(bench_top, (b->start + b->n) * cfg.granule);
+	return true;
+}
+static void give_bm(BenchBlock* b) { bm_free_run(b->start, b->n); }
+
+static double frag_list(const Strategy& st) {//峰值占用以下的外部碎片率
+	memsize total = 0, largest = 0;
+	if (st.take == take_bm) {
+		memsize run = 0, bits = min(bm_bits, bench_top / cfg.granule);
+		for (memsize i = 0; i <= bits; i++) {
+			if (i < bits && !((bm_map[i >> 6] >> (i & 63)) & 1)) {
+				if ((i & 63) == 0 && i + 64 <= bits && bm_map[i >> 6] == 0) {//整字空闲
+					run += 64;
+					i += 63;
+				}
+				else run++;
+				continue;
+			}
+			total += run;
+			largest = max(largest, run);
+			run = 0;
+		}
+	}
+	else {
+		for (Free_Node* p = block_first->next; p && p->date.address < bench_top; p = p->next) {
+			if (p->date.flag != FREE) continue;
+			memsize size = min(p->date.address + p->date.size, bench_top) - p->date.address;//去掉尾部
+			total += size;
+			largest = max(largest, size);
+		}
+	}
+	return total ? 1.0 - (double)largest / total : 0;
+}
+
+static vector<BenchOp> gen_workload(int kind, int ops, unsigned seed) {
+	//0均匀随机 1二的幂 2生产者消费者 3突发 4碎片压力
+	srand(seed);
+	vector<BenchOp> seq;
+	vector<int> live, freeSlots;
+	int slots = 0;
+	auto newSlot = [&]() {
+		if (freeSlots.empty()) return slots++;
+		int s = freeSlots.back();
+		freeSlots.pop_back();
+		return s;
+	};
+	auto doAlloc = [&](memsize size) {
+		int s = newSlot();
+		seq.push_back({ true, s, size });
+		live.push_back(s);
+	};
+	auto doFree = [&](size_t k) {//释放live中的第k个
+		seq.push_back({ false, live[k], 0 });
+		freeSlots.push_back(live[k]);
+		live[k] = live.back();
+		live.pop_back();
+	};
+	const int LIVE = 4096;//稳态下的存活块数
+	while ((int)seq.size() < ops) {
+		switch (kind) {
+		case 0:
+		case 1:
+			if (live.size() < LIVE / 2 || (live.size() < LIVE && rand() % 2))
+				doAlloc(kind == 0 ? 16 + rand() % 4081 : (memsize)1 << (4 + rand() % 9));
+			else doFree(rand() % live.size());
+			break;
+		case 2://按先进先出的寿命释放
+			if ((int)live.size() < LIVE) {
+				int s = newSlot();
+				seq.push_back({ true, s, 64 + rand() % 961 });
+				live.insert(live.begin(), s);
+			}
+			else {
+				seq.push_back({ false, live.back(), 0 });
+				freeSlots.push_back(live.back());
+				live.pop_back();
+			}
+			break;
+		case 3: {//突发：一次分配一大批，随后整批释放大半
+			int burst = 256 + rand() % 1024;
+			for (int i = 0; i < burst; i++) doAlloc(32 + rand() % 2017);
+			while (live.size() > LIVE / 8) doFree(rand() % live.size());
+			break;
+		}
+		case 4: {//交替分配大小块，释放小块留下空洞，再请求更大的块
+			for (int i = 0; i < 256; i++) {
+				doAlloc(64);
+				doAlloc(4096 + rand() % 4096);
+			}
+			//从后往前走：doFree把末尾的块换到k，末尾的块已经考虑过了
+			for (size_t k = live.size(); k-- > 0;)
+				if (seq.size() < (size_t)ops && rand() % 2 == 0 && live.size() > 1) doFree(k);
+			for (int i = 0; i < 64; i++) doAlloc(8192 + rand() % 8192);
+			while (live.size() > LIVE) doFree(rand() % live.size());
+			break;
+		}
+		}
+	}
+	return seq;
+}
+
+void bench(int ops) {//./dynamicRAM bench [每种负载的操作数]
+	const char* wname[] = { "均匀随机", "二的幂", "生产消费", "突发", "碎片压力" };
+	Strategy strategies[] = {
+		{ "FF", take_ff, give_list },
+		{ "BF", take_bf, give_list },
+		{ "BM", take_bm, give_bm },
+	};
+	float clock_cost;//两次取时钟之间的最小间隔，即计时本身的开销
+	{
+		vector<float> d(10000);
+		for (auto& x : d) {
+			auto t0 = chrono::steady_clock::now();
+			x = chrono::duration<float, nano>(chrono::steady_clock::now() - t0).count();
+		}
+		clock_cost = *min_element(d.begin(), d.end());
+	}
+	cout << "策略\t负载\t\t吞吐(ops/s)\tp99(ns)\t峰值占用\t碎片率\t失败" << endl;
+	for (int w = 0; w < 5; w++) {
+		vector<BenchOp> seq = gen_workload(w, ops, 20211 + w);
+		for (auto& st : strategies) {
+			vector<BenchBlock> blocks(seq.size());
+			int failed = 0;
+			auto replay = [&](const BenchOp& op) {
+				BenchBlock& b = blocks[op.slot];
+				if (op.alloc) {
+					b.live = st.take(op.size, &b);
+					if (!b.live) failed++;
+				}
+				else if (b.live) {
+					st.give(&b);
+					b.live = false;
+				}
+			};
+			bench_reset();//第一遍不计单次时间，只测吞吐
+			auto begin = chrono::steady_clock::now();
+			for (auto& op : seq) replay(op);
+			double sec = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+			bench_reset();//第二遍逐个计时，结束时的状态与第一遍相同
+			fill(blocks.begin(), blocks.end(), BenchBlock());
+			failed = 0;
+			vector<float> lat;
+			lat.reserve(seq.size());
+			for (auto& op : seq) {
+				auto t0 = chrono::steady_clock::now();
+				replay(op);
+				float ns = chrono::duration<float, nano>(chrono::steady_clock::now() - t0).count() - clock_cost;
+				lat.push_back(max(ns, 0.0f));
+			}
+			size_t k = lat.size() * 99 / 100;
+			nth_element(lat.begin(), lat.begin() + k, lat.end());
+			cout << st.name << "\t" << wname[w] << "\t" << (long long)(seq.size() / sec) << "\t"
+				<< (long long)lat[k] << "\t" << format_size(bench_top) << "\t\t"
+				<< frag_list(st) << "\t" << failed << endl;
+		}
+	}
+}
+
 void menu() {//菜单
 	int tag = 0;
 	int ID;
 	init();
+	bm_init(user_size());
 	while (tag != 5) {
 	    cout << "动态分区分配方式的模拟, 请选择要进行的操作:" << endl;
 		cout << "1:首次适应算法  2:最佳适应算法  3:内存回收  4:显示内存状况  5:退出" << endl;
+		cout << "6:位图分配  7:位图回收  8:显示位图状况" << endl;
 		cin >> tag;
 		switch (tag) {
 		case 1:
@@ -229,6 +847,18 @@ void menu() {//菜单
 		case 4:
 			show();
 			break;
+		case 6:
+			alloc(tag);
+			break;
+		case 7:
+			cout << "请输入需要回收的作业号：";
+			cin >> ID;
+			if (bm_release(ID)) cout << "回收成功！" << endl;
+			else cout << "回收失败！" << endl;
+			break;
+		case 8:
+			show_bitmap();
+			break;
 		}
 	}
 
@@ -239,7 +869,7 @@ void fiftyJobFF() {
     long long mem, alocOrNot, Id;
     for(int i = 0; i < 50; i++) {
         srand((unsigned)time(NULL));
-        mem = rand() % 50;
+        mem = rand() % 50 * MB;
         alocOrNot = rand() % 2;
         
         if(alocOrNot == 1) {
@@ -259,7 +889,7 @@ void fiftyJobBF() {
     long long mem, alocOrNot, Id;
     for(int i = 0; i < 50; i++) {
         srand((unsigned)time(NULL));
-        mem = rand() % 50;
+        mem = rand() % 50 * MB;
         alocOrNot = rand() % 2;
         
         if(alocOrNot == 1) {
@@ -274,9 +904,333 @@ void fiftyJobBF() {
     show();
 }
 
-int main() {
+void fiftyJobBM() {
+    bm_init(user_size());
+    long long mem, alocOrNot, Id;
+    for(int i = 0; i < 50; i++) {
+        mem = rand() % 50 * MB;
+        alocOrNot = rand() % 2;
+        
+        if(alocOrNot == 1) {
+            bitmap_fit(i, mem);
+        }
+        else if (alocOrNot != 1 && i > 1){
+            Id = rand() % i;
+            bm_release(Id);
+        }
+    }
+    show_bitmap();
+}
+
+static const char* USAGE = "用法：./dynamicRAM [-a 内存大小] [-r 保留区大小] [-g 对齐粒度] [-p 位图粒度] [menu | mt [线程数] | bench [操作数]]";
+
+int main(int argc, char* argv[]) {
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; i += 2) {
+		if (strchr("argp", argv[i][1]) == NULL || argv[i][1] == 0 || argv[i][2] != 0 || i + 1 == argc) {
+			cout << "未知选项或缺少参数：" << argv[i] << endl << USAGE << endl;
+			return 1;
+		}
+		memsize v = parse_size(argv[i + 1]);
+		if (v < 0 || (v == 0 && argv[i][1] != 'r')) {
+			cout << "参数错误：" << argv[i] << " " << argv[i + 1] << endl;
+			return 1;
+		}
+		switch (argv[i][1]) {
+		case 'a': cfg.arena = v; break;
+		case 'r': cfg.reserved = v; break;
+		case 'g': cfg.align = v; break;
+		case 'p': cfg.granule = v; break;
+		}
+	}
+	cfg.reserved = align_up(cfg.reserved, cfg.align);
+	if (cfg.reserved >= cfg.arena) {
+		cout << "保留区不能超过内存总大小" << endl;
+		return 1;
+	}
+	if (i < argc && strcmp(argv[i], "mt") == 0) {//并发模式扩展性测试
+		mtBench(i + 1 < argc ? atoi(argv[i + 1]) : 8);
+		return 0;
+	}
+	if (i < argc && strcmp(argv[i], "bench") == 0) {//分配策略基准测试
+		bench(i + 1 < argc ? atoi(argv[i + 1]) : 200000);
+		return 0;
+	}
+	if (i < argc && strcmp(argv[i], "menu") == 0) {
+		menu();
+		return 0;
+	}
 	// menu();   // To test FF and BF
     fiftyJobFF();
     fiftyJobBF();
+    fiftyJobBM();
 	return 0;
 }
+#else
+
+/*
+ * 库模式：用 mmap 映射的一整块地址空间作为堆，按上面的分配策略管理，
+ * 对外提供 malloc/free/realloc 等接口，可通过 LD_PRELOAD 替换 glibc：
+ *   g++ -O2 -shared -fPIC -DDYNRAM_LIB dynamicRAM.cpp -o libdynram.so -pthread
+ *   LD_PRELOAD=./libdynram.so DYNRAM_STRATEGY=bf ./prog
+ * 环境变量：
+ *   DYNRAM_STRATEGY  ff（首次适应，默认）、bf（最佳适应）、bm（位图）
+ *   DYNRAM_ARENA     映射的地址空间大小，默认64G（MAP_NORESERVE，不占物理内存）
+ *   DYNRAM_GRANULE   位图模式的粒度，默认64B
+ *   DYNRAM_STATS     设置后在退出时向stderr输出统计
+ * 树中没有伙伴系统，位图模式代替它作为第三种策略。
+ * 所有操作由一把全局锁保护。每块前有16字节的块头，记录分区位置。
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define LIB_ALIGN 16//malloc返回地址的对齐
+#define LIB_TRIM (256 * KB)//回收不小于它的块时把其中的整页还给系统
+#define LIB_ID 1
+
+struct LibHeader {//紧挨在用户指针之前
+	uint64_t ref;//首次/最佳适应：分区结点；位图：起始粒度
+	memsize end;//整块的结束偏移
+};
+
+enum { LIB_FF, LIB_BF, LIB_BM };
+
+static pthread_mutex_t lib_lock = PTHREAD_MUTEX_INITIALIZER;
+static int lib_strategy = LIB_FF;
+static bool lib_ready;
+static bool lib_atfork;
+static char* lib_base;//堆的起始地址
+static memsize lib_page;
+static memsize lib_used;//当前已分配的字节数（含块头）
+static memsize lib_peak;//已分配字节数的峰值
+static memsize lib_top;//用到过的最高偏移，即堆占用的地址范围
+static long long lib_calls;
+
+static bool lib_init() {//首次调用malloc时初始化，调用者持有锁
+	const char* env = getenv("DYNRAM_STRATEGY");
+	if (env && strcmp(env, "bf") == 0) lib_strategy = LIB_BF;
+	else if (env && strcmp(env, "bm") == 0) lib_strategy = LIB_BM;
+	cfg.arena = 64 * GB;
+	cfg.reserved = 0;
+	cfg.align = LIB_ALIGN;
+	cfg.granule = 64;
+	if ((env = getenv("DYNRAM_ARENA")) && parse_size(env) > 0)
+		cfg.arena = parse_size(env) / LIB_ALIGN * LIB_ALIGN;
+	if ((env = getenv("DYNRAM_GRANULE")) && parse_size(env) >= LIB_ALIGN)
+		cfg.granule = align_up(parse_size(env), LIB_ALIGN);
+	lib_page = sysconf(_SC_PAGESIZE);
+	void* base = mmap(NULL, cfg.arena, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (base == MAP_FAILED) return false;
+	lib_base = (char*)base;
+	if (lib_strategy == LIB_BM) bm_init(cfg.arena);
+	else init_list(&block_first, &block_last, 0, cfg.arena);
+	lib_ready = true;
+	return true;
+}
+
+static void lib_prepare() { pthread_mutex_lock(&lib_lock); }
+static void lib_parent() { pthread_mutex_unlock(&lib_lock); }
+static void lib_child() { pthread_mutex_init(&lib_lock, NULL); }
+
+//按策略取一块，返回起始偏移并通过end返回结束偏移，失败返回-1
+static memsize lib_take(memsize need, uint64_t* ref, memsize* end) {
+	if (lib_strategy == LIB_BM) {
+		memsize n = (need + cfg.granule - 1) / cfg.granule;
+		memsize start = bm_alloc_run(n);
+		if (start < 0) return -1;
+		*ref = start;
+		*end = (start + n) * cfg.granule;
+		return start * cfg.granule;
+	}
+	Free_Node* p = lib_strategy == LIB_BF ? best_fit_in(block_first, LIB_ID, need)
+		: first_fit_in(block_first, LIB_ID, need);
+	if (p == NULL) return -1;
+	*ref = (uint64_t)p;
+	*end = p->date.address + p->date.size;
+	return p->date.address;
+}
+
+static void* lib_alloc(size_t size, size_t align) {//分配size字节，用户地址按align对齐
+	if (size > (size_t)(64 * TB)) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	memsize need = align_up((memsize)size, LIB_ALIGN) + sizeof(LibHeader);
+	if (align > LIB_ALIGN) need += align;//为对齐留出余量
+	pthread_mutex_lock(&lib_lock);
+	if (!lib_ready && !lib_init()) {
+		pthread_mutex_unlock(&lib_lock);
+		errno = ENOMEM;
+		return NULL;
+	}
+	uint64_t ref;
+	memsize end;
+	memsize off = lib_take(need, &ref, &end);
+	if (off < 0) {
+		pthread_mutex_unlock(&lib_lock);
+		errno = ENOMEM;
+		return NULL;
+	}
+	lib_used += end - off;
+	if (lib_used > lib_peak) lib_peak = lib_used;
+	if (end > lib_top) lib_top = end;
+	lib_calls++;
+	bool first = !lib_atfork;
+	lib_atfork = true;
+	pthread_mutex_unlock(&lib_lock);
+	if (first)//pthread_atfork可能调用malloc，放在锁外注册
+		pthread_atfork(lib_prepare, lib_parent, lib_child);
+
+	uintptr_t user = (uintptr_t)(lib_base + off) + sizeof(LibHeader);
+	if (align > LIB_ALIGN) user = (user + align - 1) & ~(uintptr_t)(align - 1);
+	LibHeader* h = (LibHeader*)user - 1;
+	h->ref = ref;
+	h->end = end;
+	return (void*)user;
+}
+
+static LibHeader* lib_header(void* ptr) {
+	return (LibHeader*)ptr - 1;
+}
+
+static size_t lib_usable(void* ptr) {
+	return (size_t)(lib_base + lib_header(ptr)->end - (char*)ptr);
+}
+
+static void lib_release(void* ptr) {
+	LibHeader h = *lib_header(ptr);
+	memsize start, end = h.end;
+	//大块的整页先交还系统，再放回空闲结构：放回之后别的线程随时可能拿到这段地址，
+	//那时再清零就会毁掉它的数据。块的起点不晚于块头，从块头算起只会少还，不会越界
+	memsize head = (memsize)((char*)lib_header(ptr) - lib_base);
+	if (end - head >= LIB_TRIM) {
+		memsize lo = align_up(head, lib_page), hi = end / lib_page * lib_page;
+		if (hi > lo) madvise(lib_base + lo, hi - lo, MADV_DONTNEED);
+	}
+	pthread_mutex_lock(&lib_lock);
+	if (lib_strategy == LIB_BM) {
+		start = (memsize)h.ref * cfg.granule;
+		bm_free_run((memsize)h.ref, (end - start) / cfg.granule);
+	}
+	else {
+		start = ((Free_Node*)h.ref)->date.address;
+		release_node((Free_Node*)h.ref);
+	}
+	lib_used -= end - start;
+	lib_calls++;
+	pthread_mutex_unlock(&lib_lock);
+}
+
+static bool lib_grow(void* ptr, size_t size) {//首次/最佳适应下尝试向后原地扩展
+	if (lib_strategy == LIB_BM) return false;
+	LibHeader* h = lib_header(ptr);
+	memsize want = (memsize)((char*)ptr - lib_base) + align_up((memsize)size, LIB_ALIGN);
+	pthread_mutex_lock(&lib_lock);
+	Free_Node* p = (Free_Node*)h->ref;
+	Free_Node* q = p->next;
+	memsize extra = want - h->end;
+	bool ok = q && q->date.flag == FREE && q->date.size >= extra;
+	if (ok) {
+		if (q->date.size == extra) {//后一个空闲区刚好用完
+			p->next = q->next;
+			if (q->next) q->next->front = p;
+			delete_node(q);
+		}
+		else {
+			q->date.address += extra;
+			q->date.size -= extra;
+		}
+		p->date.size += extra;
+		h->end = want;
+		lib_used += extra;
+		if (lib_used > lib_peak) lib_peak = lib_used;
+		if (want > lib_top) lib_top = want;
+	}
+	pthread_mutex_unlock(&lib_lock);
+	return ok;
+}
+
+extern "C" {
+
+void* malloc(size_t size) noexcept {
+	return lib_alloc(size, LIB_ALIGN);
+}
+
+void free(void* ptr) noexcept {
+	if (ptr) lib_release(ptr);
+}
+
+void* calloc(size_t n, size_t size) noexcept {
+	size_t total;
+	if (__builtin_mul_overflow(n, size, &total)) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	void* p = lib_alloc(total, LIB_ALIGN);
+	if (p) memset(p, 0, total);
+	return p;
+}
+
+void* realloc(void* ptr, size_t size) noexcept {
+	if (ptr == NULL) return lib_alloc(size, LIB_ALIGN);
+	if (size == 0) {
+		lib_release(ptr);
+		return NULL;
+	}
+	size_t old = lib_usable(ptr);
+	if (size <= old || lib_grow(ptr, size)) return ptr;
+	void* p = lib_alloc(size, LIB_ALIGN);
+	if (p == NULL) return NULL;
+	memcpy(p, ptr, old);
+	lib_release(ptr);
+	return p;
+}
+
+int posix_memalign(void** out, size_t align, size_t size) noexcept {
+	if (align < sizeof(void*) || (align & (align - 1))) return EINVAL;
+	void* p = lib_alloc(size, align);
+	if (p == NULL) return ENOMEM;
+	*out = p;
+	return 0;
+}
+
+void* aligned_alloc(size_t align, size_t size) noexcept {
+	if (align == 0 || (align & (align - 1))) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return lib_alloc(size, align);
+}
+
+void* memalign(size_t align, size_t size) noexcept {
+	return aligned_alloc(align, size);
+}
+
+void* valloc(size_t size) noexcept {
+	return lib_alloc(size, sysconf(_SC_PAGESIZE));
+}
+
+void* pvalloc(size_t size) noexcept {
+	size_t page = sysconf(_SC_PAGESIZE);
+	return lib_alloc((size + page - 1) / page * page, page);
+}
+
+size_t malloc_usable_size(void* ptr) noexcept {
+	return ptr ? lib_usable(ptr) : 0;
+}
+
+}
+
+__attribute__((destructor)) static void lib_report() {
+	if (!getenv("DYNRAM_STATS") || !lib_ready) return;
+	const char* name[] = { "ff", "bf", "bm" };
+	char buf[256];
+	int n = snprintf(buf, sizeof(buf),
+		"[dynram] strategy=%s calls=%lld used=%lld peak=%lld top=%lld\n",
+		name[lib_strategy], lib_calls, lib_used, lib_peak, lib_top);
+	if (write(2, buf, n) < 0) return;
+}
+#endif